@@ -5,6 +5,13 @@
 #include "camera.h"
 #include "model.h"
 #include "shader.h"
+#include "clusteredlights.h"
+#include "gbuffer.h"
+#include "normalmatrix.h"
+#include "demorunner.h"
+#include <random>
+#include <cstdlib>
+#include <chrono>
 using namespace std;
 
 
@@ -12,6 +19,8 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void scatterLights(ClusteredLights& lights, unsigned int count);
 unsigned int loadTexture(char const* path);
 
 const unsigned int SCR_WIDTH = 800;
@@ -25,95 +34,221 @@ Camera camera(glm::vec3(1.0f, 5.0f, -22.0f));
 
 glm::vec3 lightPos(1.2f, 10.0f, -10.0f);
 
+// '=' and '-' multiply / divide the number of point lights by 10
+unsigned int lightCount = 1;
+bool lightCountChanged = false;
+
+// 'G' switches between forward and deferred shading of the same scene, LOGL_DEFERRED starts deferred
+bool deferred = false;
+
+// 'Z' toggles a depth prepass in front of the forward pass, so each pixel is lit once
+bool depthPrepass = false;
+
+// LOGL_LIGHT_BENCHMARK renders BENCHMARK_FRAMES frames per light count, forward and then
+// deferred, and prints the timings
+const unsigned int BENCHMARK_LIGHT_COUNTS[] = { 1, 10, 100, 1000, 10000 };
+const unsigned int BENCHMARK_FRAMES = 120;
+
 int main()
 {
-    // glfw: initialize and configure
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-
-    // glfw window creation
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    if (window == NULL)
-    {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
+    // context and frame loop, headless with LOGL_HEADLESS (demorunner.h)
+    DemoRunner runner("lights", SCR_WIDTH, SCR_HEIGHT);
+    if (!runner.Ok())
         return -1;
-    }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-
-    // glad: load all OpenGL function pointers
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    GLFWwindow* window = runner.Window();
+    if (runner.Interactive())
     {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetKeyCallback(window, key_callback);
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     }
 
+    // LOGL_MODEL=<file> loads another model, e.g. resources/objects/cyborg/cyborg.obj with its normal map
+    const char* modelPath = getenv("LOGL_MODEL");
+	Model modelObject(modelPath != nullptr ? modelPath : "resources/objects/hutao/hutao.obj", false, true);
+
     // build and compile our shader zprogram
-    Shader ourShader("vs.vert", "fs.frag", "gs.geom");
+    ShaderDefines materialDefines = ShaderDefines().Set("NORMAL_MAP", modelObject.HasNormalMaps());
+    Shader ourShader("vs_clustered.vert", "fs_clustered.frag", nullptr, materialDefines);
     Shader lightShader("light.vert", "light.frag");
-
-	Model modelObject("resources/objects/hutao/hutao.obj", false);
-
-    // light
+    Shader gBufferShader("vs_clustered.vert", "fs_gbuffer.frag", nullptr, materialDefines);
+    Shader deferredShader("vs_framebuffer.vert", "fs_deferred.frag");
+    Shader prepassShader("vs_prepass.vert", "fs_depthmap.frag");
+    ShaderBinaryCache::PrintStats();
+
+    // lights, assigned to clusters on the CPU every frame
+    ClusteredLights clusteredLights;
+    scatterLights(clusteredLights, lightCount);
     ourShader.use();
-    ourShader.setVec3("pointLights[0].position", lightPos);
-    ourShader.setVec3("pointLights[0].ambient", glm::vec3(0.5f));
-    ourShader.setVec3("pointLights[0].diffuse", glm::vec3(0.0f, 1.0f, 0.0f));
-    ourShader.setVec3("pointLights[0].specular", glm::vec3(1.0f));
-    ourShader.setFloat("pointLights[0].constant", 1.0f);
-    ourShader.setFloat("pointLights[0].linear", 0.09f);
-    ourShader.setFloat("pointLights[0].quadratic", 0.032f);
-
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    ourShader.setVec3("ambient", glm::vec3(0.05f));
+    deferredShader.use();
+    deferredShader.setVec3("ambient", glm::vec3(0.05f));
+
+    // deferred path: G-buffer and the fullscreen quad of the lighting pass
+    GBuffer gBuffer;
+    float quadVertices[] = { // vertex attributes for a quad that fills the entire screen in Normalized Device Coordinates.
+        // positions   // texCoords
+        -1.0f,  1.0f,  0.0f, 1.0f,
+        -1.0f, -1.0f,  0.0f, 0.0f,
+         1.0f, -1.0f,  1.0f, 0.0f,
+
+        -1.0f,  1.0f,  0.0f, 1.0f,
+         1.0f, -1.0f,  1.0f, 0.0f,
+         1.0f,  1.0f,  1.0f, 1.0f
+    };
+    unsigned int quadVAO, quadVBO;
+    glGenVertexArrays(1, &quadVAO);
+    glGenBuffers(1, &quadVBO);
+    glBindVertexArray(quadVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+    glBindVertexArray(0);
+    deferred = getenv("LOGL_DEFERRED") != nullptr;
+
+    bool benchmark = getenv("LOGL_LIGHT_BENCHMARK") != nullptr;
+    unsigned int benchmarkStep = 0, benchmarkFrame = 0;
+    double benchmarkAssignMs = 0.0, benchmarkFrameMs = 0.0;
+    if (benchmark)
+    {
+        scatterLights(clusteredLights, BENCHMARK_LIGHT_COUNTS[0]);
+        deferred = false;
+        runner.SetSwapInterval(0);
+    }
+
     // render loop
-    while (!glfwWindowShouldClose(window))
+    while (runner.Running())
     {
         // input
-        processInput(window);
+        runner.UpdateCamera(camera);
+        if (runner.Interactive())
+            processInput(window);
 
         // render
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         glEnable(GL_DEPTH_TEST);
 
-        float currentTime = glfwGetTime();
+        float currentTime = runner.Time();
+        auto frameStart = std::chrono::steady_clock::now();
         deltaTime = currentTime - lastTime;
         lastTime = currentTime;
 
-		ourShader.use();
-
         // transform mvp
         glm::mat4 view = glm::mat4(1.0f);
         glm::mat4 projection = glm::mat4(1.0f);
 
+        // the cluster grid and the projection both follow the framebuffer
+        int framebufferWidth, framebufferHeight;
+        runner.FramebufferSize(&framebufferWidth, &framebufferHeight);
+        float aspect = framebufferHeight > 0 ? (float)framebufferWidth / (float)framebufferHeight : (float)SCR_WIDTH / (float)SCR_HEIGHT;
+
         view = camera.GetViewMatirx();
-        projection = glm::perspective(glm::radians(camera.Fov), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        projection = glm::perspective(glm::radians(camera.Fov), aspect, 0.1f, 100.0f);
 
-        ourShader.setMat4("view", view);
-        ourShader.setMat4("projection", projection);
+        if (lightCountChanged)
+        {
+            scatterLights(clusteredLights, lightCount);
+            lightCountChanged = false;
+        }
+        clusteredLights.Configure(glm::radians(camera.Fov), aspect, 0.1f, 100.0f, framebufferWidth, framebufferHeight);
+        clusteredLights.Update(view);
 
 
 		glm::mat4 model = glm::mat4(1.0f);
 		model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f)); 
 		model = glm::scale(model, glm::vec3(0.5f, 0.5f, 0.5f));
-		ourShader.setMat4("model", model);
-		modelObject.Draw(ourShader);
-
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+		glm::mat3 normalMatrix = NormalMatrix::FromModel(model);
+
+        if (!deferred)
+        {
+            if (depthPrepass)
+            {
+                // depth only, from the position stream
+                glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                prepassShader.use();
+                prepassShader.setMat4("view", view);
+                prepassShader.setMat4("projection", projection);
+                prepassShader.setMat4("model", model);
+                modelObject.DrawDepth();
+                glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                glDepthFunc(GL_LEQUAL);
+                glDepthMask(GL_FALSE);
+            }
+
+            // forward: every rasterized fragment is lit, overdraw included unless the prepass ran
+            ourShader.use();
+            ourShader.setMat4("view", view);
+            ourShader.setMat4("projection", projection);
+            ourShader.setVec3("viewPos", camera.Position);
+            clusteredLights.Bind(ourShader, 8);
+            ourShader.setMat4("model", model);
+            ourShader.setMat3("normalMatrix", normalMatrix);
+            modelObject.Draw(ourShader);
+
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
+        }
+        else
+        {
+            // deferred: the geometry pass only writes material data ...
+            gBuffer.Resize(framebufferWidth, framebufferHeight);
+            glBindFramebuffer(GL_FRAMEBUFFER, gBuffer.FBO);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            gBufferShader.use();
+            gBufferShader.setMat4("view", view);
+            gBufferShader.setMat4("projection", projection);
+            gBufferShader.setMat4("model", model);
+            gBufferShader.setMat3("normalMatrix", normalMatrix);
+            modelObject.Draw(gBufferShader);
+
+            // ... and the lighting pass shades each visible pixel once
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glDisable(GL_DEPTH_TEST);
+            deferredShader.use();
+            deferredShader.setMat4("inverseProjection", glm::inverse(projection));
+            deferredShader.setMat4("inverseView", glm::inverse(view));
+            deferredShader.setVec3("viewPos", camera.Position);
+            gBuffer.BindTextures(deferredShader, 0);
+            clusteredLights.Bind(deferredShader, 8);
+            glBindVertexArray(quadVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            glBindVertexArray(0);
+            glEnable(GL_DEPTH_TEST);
+        }
+
+        if (benchmark)
+        {
+            // wait for the GPU so the frame time covers the shading of this light count
+            glFinish();
+            benchmarkAssignMs += clusteredLights.AssignMs();
+            benchmarkFrameMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+            if (++benchmarkFrame == BENCHMARK_FRAMES)
+            {
+                std::cout << "LIGHTS::BENCHMARK " << (deferred ? "deferred " : "forward  ") << clusteredLights.Lights.size() << " lights: assign " << benchmarkAssignMs / BENCHMARK_FRAMES
+                    << " ms, frame " << benchmarkFrameMs / BENCHMARK_FRAMES << " ms, " << clusteredLights.IndexCount() << " cluster entries" << std::endl;
+                benchmarkFrame = 0;
+                benchmarkAssignMs = benchmarkFrameMs = 0.0;
+                // every light count runs forward then deferred
+                if (++benchmarkStep == 2 * sizeof(BENCHMARK_LIGHT_COUNTS) / sizeof(BENCHMARK_LIGHT_COUNTS[0]))
+                    runner.Stop();
+                else
+                {
+                    deferred = benchmarkStep % 2 == 1;
+                    scatterLights(clusteredLights, BENCHMARK_LIGHT_COUNTS[benchmarkStep / 2]);
+                }
+            }
+        }
+
+        runner.EndFrame();
     }
 
-    glfwTerminate();
-    return 0;
+    return runner.ExitCode();
 }
 
 void processInput(GLFWwindow* window)
@@ -135,6 +270,64 @@ void processInput(GLFWwindow* window)
         cout<< "CAMERA POSITION: " + to_string(camera.Position.x) +   "      " + to_string(camera.Position.y) + "      " + to_string(camera.Position.z);
 }
 
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    if (action != GLFW_PRESS)
+        return;
+
+    if (key == GLFW_KEY_EQUAL && lightCount < 10000)
+    {
+        lightCount *= 10;
+        lightCountChanged = true;
+    }
+    if (key == GLFW_KEY_MINUS && lightCount > 1)
+    {
+        lightCount /= 10;
+        lightCountChanged = true;
+    }
+    if (lightCountChanged)
+        cout << "LIGHTS: " << lightCount << endl;
+
+    if (key == GLFW_KEY_Z)
+    {
+        depthPrepass = !depthPrepass;
+        cout << "DEPTH PREPASS: " << (depthPrepass ? "on" : "off") << endl;
+    }
+    if (key == GLFW_KEY_G)
+    {
+        deferred = !deferred;
+        cout << "SHADING: " << (deferred ? "deferred" : "forward") << endl;
+    }
+}
+
+// the first light is the scene's main light, the others are scattered with a fixed
+// seed around the model so every run and benchmark sees the same distribution.
+// Radii shrink with the count to keep roughly the same overlap per pixel.
+void scatterLights(ClusteredLights& lights, unsigned int count)
+{
+    lights.Lights.clear();
+
+    ClusteredLight mainLight;
+    mainLight.Position = lightPos;
+    mainLight.Radius = 30.0f;
+    mainLight.Color = glm::vec3(0.0f, 1.0f, 0.0f);
+    mainLight.Intensity = 40.0f;
+    lights.Lights.push_back(mainLight);
+
+    std::mt19937 random(1337);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    float radiusScale = std::min(1.0f, std::cbrt(100.0f / count));
+    for (unsigned int i = 1; i < count; i++)
+    {
+        ClusteredLight light;
+        light.Position = glm::vec3(-10.0f + 20.0f * unit(random), 15.0f * unit(random), -10.0f + 20.0f * unit(random));
+        light.Radius = (1.5f + 3.0f * unit(random)) * radiusScale;
+        light.Color = glm::vec3(unit(random), unit(random), unit(random));
+        light.Intensity = 2.0f + 4.0f * unit(random);
+        lights.Lights.push_back(light);
+    }
+}
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     glViewport(0, 0, width, height);
@@ -167,6 +360,7 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 
 unsigned int loadTexture(char const* path)
 {
+	GPU_MEMORY_OWNER("texture");
 	unsigned int textureID;
 	glGenTextures(1, &textureID);
 
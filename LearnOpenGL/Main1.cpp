@@ -5,6 +5,11 @@
 #include "camera.h"
 #include "model.h"
 #include "shader.h"
+#include "normalmatrix.h"
+#include "reversez.h"
+#include "demorunner.h"
+#include "gpuprofiler.h"
+#include "framegraph.h"
 #include <map>
 using namespace std;
 
@@ -31,40 +36,20 @@ float lastFrame = 0.0f;
 
 int main()
 {
-    // glfw: initialize and configure
-    // ------------------------------
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-
-    // glfw window creation
-    // --------------------
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    if (window == NULL)
-    {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
+    // context and frame loop, headless with LOGL_HEADLESS (demorunner.h)
+    // --------------------------------------------------------------------
+    DemoRunner runner("blending", SCR_WIDTH, SCR_HEIGHT);
+    if (!runner.Ok())
         return -1;
-    }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-
-    // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-    // glad: load all OpenGL function pointers
-    // ---------------------------------------
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    GLFWwindow* window = runner.Window();
+    if (runner.Interactive())
     {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+
+        // tell GLFW to capture our mouse
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     }
 
      //configure global opengl state
@@ -72,12 +57,16 @@ int main()
     //glEnable(GL_DEPTH_TEST);
     //glDepthFunc(GL_LESS); // always pass the depth test (same effect as glDisable(GL_DEPTH_TEST))
 
+    ReverseZ::Enable();
+
     // build and compile shaders
+    // the batch only submits them, the driver compiles while the buffers and textures below load
     // -------------------------
-    Shader shader("vs_test.vert", "fs_test.frag");
-    Shader singleShader("vs_test.vert", "fs_test2.frag");
-    Shader screenShader("vs_framebuffer.vert", "fs_framebuffer.frag");
-    Shader skyboxShader("vs_skybox.vert", "fs_skybox.frag");
+    ShaderBatch shaderBatch;
+    Shader shader = shaderBatch.Add("vs_test.vert", "fs_test.frag");
+    Shader singleShader = shaderBatch.Add("vs_test.vert", "fs_test2.frag");
+    Shader screenShader = shaderBatch.Add("vs_framebuffer.vert", "fs_framebuffer.frag");
+    Shader skyboxShader = shaderBatch.Add("vs_skybox.vert", "fs_skybox.frag", nullptr, ReverseZ::Defines());
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
@@ -199,12 +188,12 @@ int main()
          1.0f, -1.0f,  1.0f
     };
 
-	vector<glm::vec3> vegetation;
-	vegetation.push_back(glm::vec3(-1.5f, 0.0f, -0.48f));
-	vegetation.push_back(glm::vec3(1.5f, 0.0f, 0.51f));
-	vegetation.push_back(glm::vec3(0.0f, 0.0f, 0.7f));
-	vegetation.push_back(glm::vec3(-0.3f, 0.0f, -2.3f));
-	vegetation.push_back(glm::vec3(0.5f, 0.0f, -0.6f));
+    vector<glm::vec3> vegetation;
+    vegetation.push_back(glm::vec3(-1.5f, 0.0f, -0.48f));
+    vegetation.push_back(glm::vec3(1.5f, 0.0f, 0.51f));
+    vegetation.push_back(glm::vec3(0.0f, 0.0f, 0.7f));
+    vegetation.push_back(glm::vec3(-0.3f, 0.0f, -2.3f));
+    vegetation.push_back(glm::vec3(0.5f, 0.0f, -0.6f));
     // cube VAO
     unsigned int cubeVAO, cubeVBO;
     glGenVertexArrays(1, &cubeVAO);
@@ -266,34 +255,12 @@ int main()
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
 
-    // FBO
-    unsigned int framebuffer;
-    glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-    // create a color attachment texture
-    unsigned int textureColorbuffer;
-    glGenTextures(1, &textureColorbuffer);
-    glBindTexture(GL_TEXTURE_2D, textureColorbuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureColorbuffer, 0);
-    // create a renderbuffer object for depth and stencil attachment (we won't be sampling these)
-    unsigned int rbo;
-    glGenRenderbuffers(1, &rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT); // use a single renderbuffer object for both a depth AND stencil buffer.
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo); // now actually attach it
-    // now that we actually created the framebuffer and added all attachments we want to check if it is actually complete now
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
     // load textures
     // -------------
-    unsigned int cubeTexture = loadTexture("resources/textures/marble.jpg");
-    unsigned int floorTexture = loadTexture("resources/textures/metal.png");
-    unsigned int grassTexture = loadTexture("resources/textures/grass.png");
-    unsigned int windowTexture = loadTexture("resources/textures/window.png");
+    GLTexture cubeTexture(loadTexture("resources/textures/marble.jpg"));
+    GLTexture floorTexture(loadTexture("resources/textures/metal.png"));
+    GLTexture grassTexture(loadTexture("resources/textures/grass.png"));
+    GLTexture windowTexture(loadTexture("resources/textures/window.png"));
 
     vector<std::string> cube
     {
@@ -304,10 +271,14 @@ int main()
         "resources/textures/skybox/front.jpg",
         "resources/textures/skybox/back.jpg"
     };
-    unsigned int cubemapTexture = loadCubeTextrue(cube);
+    GLTexture cubemapTexture(loadCubeTextrue(cube));
+
+    cout << "shaders ready after asset loading: " << shaderBatch.Progress() * 100.0f << "%" << endl;
+    shaderBatch.WaitAll();
+    ShaderBinaryCache::PrintStats();
 
     glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
+    glDepthFunc(ReverseZ::DepthFunc());
     glEnable(GL_STENCIL_TEST);
     glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
     glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
@@ -325,13 +296,16 @@ int main()
     skyboxShader.use();
     skyboxShader.setInt("skybox", 0);
 
+    // scene -> skybox -> post, re-declared every frame
+    FrameGraph graph(runner.Targets());
+
     // render loop
     // -----------
-    while (!glfwWindowShouldClose(window))
+    while (runner.Running())
     {
         // per-frame time logic
         // --------------------
-        float currentFrame = static_cast<float>(glfwGetTime());
+        float currentFrame = runner.Time();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
@@ -344,122 +318,156 @@ int main()
 
         // input
         // -----
-        processInput(window);
+        runner.UpdateCamera(camera);
+        if (runner.Interactive())
+            processInput(window);
 
         // render
         // ------
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-
-        singleShader.use();
-        glm::mat4 model = glm::mat4(1.0f);
-        glm::mat4 view = camera.GetViewMatirx();
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Fov), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        singleShader.setMat4("view", view);
-        singleShader.setMat4("projection", projection);
-
-		shader.use();
-		shader.setMat4("view", view);
-		shader.setMat4("projection", projection);
-        shader.setVec3("cameraPos", camera.Position);
-        // floor
-        glEnable(GL_DEPTH_TEST);
-        glStencilMask(0x00);
-        glBindVertexArray(planeVAO);
-        glBindTexture(GL_TEXTURE_2D, floorTexture);
-        shader.setMat4("model", glm::mat4(1.0f));
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glBindVertexArray(0);
-
-        glStencilFunc(GL_ALWAYS, 1, 0xff);
-        glStencilMask(0xff);
-
-        // cubes
-        glBindVertexArray(cubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, cubeTexture);
-        model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
-        shader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-
-        glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-        glStencilMask(0x00);
-        glDisable(GL_DEPTH_TEST);
-  //      singleShader.use();
-
-  //      // cubes
-		//model = glm::mat4(1.0f);
-  //      model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
-  //      model = glm::scale(model, glm::vec3(1.1f,1.1f, 1.1f));
-  //      singleShader.setMat4("model", model);
-  //      glDrawArrays(GL_TRIANGLES, 0, 36);
-
-        glStencilFunc(GL_ALWAYS, 1, 0xff);
-        glStencilMask(0xff);
-        glEnable(GL_DEPTH_TEST);
-        glClear(GL_STENCIL_BUFFER_BIT);
-
-        shader.use();
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
-        shader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-
-        glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-        glStencilMask(0x00);
-        glDisable(GL_DEPTH_TEST);
-
-     /*   singleShader.use();
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(1.1f, 1.1f, 1.1f));
-        singleShader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);*/
-
-        glStencilMask(0xFF);
-        glStencilFunc(GL_ALWAYS, 0, 0xFF);
-        glEnable(GL_DEPTH_TEST);
-
-        // vegetation
-        shader.use();
-        glBindVertexArray(vegetationVAO);
-        glBindTexture(GL_TEXTURE_2D, windowTexture);
-        for (map<float, glm::vec3>::reverse_iterator it = sortedWindows.rbegin(); it != sortedWindows.rend(); ++it)
+        // the scene renders offscreen at the framebuffer size, float depth for reverse-Z
+        RenderTargetDesc sceneDesc;
+        runner.FramebufferSize(&sceneDesc.Width, &sceneDesc.Height);
+        if (sceneDesc.Width == 0 || sceneDesc.Height == 0)
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, it->second);
-            shader.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+            runner.EndFrame();
+            continue;
         }
+        sceneDesc.ColorFormat = GL_RGB8;
+        sceneDesc.DepthFormat = GL_DEPTH32F_STENCIL8;
+        graph.SetBackbufferSize(sceneDesc.Width, sceneDesc.Height);
+        float aspect = (float)sceneDesc.Width / (float)sceneDesc.Height;
 
-        glDepthFunc(GL_LEQUAL);
-        skyboxShader.use();
-        view = glm::mat4(glm::mat3(camera.GetViewMatirx()));
-        projection = glm::perspective(glm::radians(camera.Fov), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
-        glBindVertexArray(skyboxVAO);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-
-        glDepthFunc(GL_LESS);
-
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glDisable(GL_DEPTH_TEST);
-        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        screenShader.use();
-        glBindVertexArray(quadVAO);
-        glBindTexture(GL_TEXTURE_2D, textureColorbuffer);	// use the color attachment texture as the texture of the quad plane
-        //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        glm::mat4 model = glm::mat4(1.0f);
+        glm::mat4 view = camera.GetViewMatirx();
+        glm::mat4 projection = ReverseZ::Perspective(glm::radians(camera.Fov), aspect, 0.1f, 100.0f);
+        FrameGraph::Resource scene;
+        graph.AddPass("scene",
+            [&](FrameGraph::PassBuilder& pass) { scene = pass.Create("scene", sceneDesc); },
+            [&]() {
+                glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+                singleShader.use();
+                singleShader.setMat4("view", view);
+                singleShader.setMat4("projection", projection);
+
+                shader.use();
+                shader.setMat4("view", view);
+                shader.setMat4("projection", projection);
+                shader.setVec3("cameraPos", camera.Position);
+                // floor
+                glEnable(GL_DEPTH_TEST);
+                glStencilMask(0x00);
+                glBindVertexArray(planeVAO);
+                glBindTexture(GL_TEXTURE_2D, floorTexture);
+                shader.setMat4("model", glm::mat4(1.0f));
+                shader.setMat3("normalMatrix", glm::mat3(1.0f));
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+                glBindVertexArray(0);
+
+                glStencilFunc(GL_ALWAYS, 1, 0xff);
+                glStencilMask(0xff);
+
+                // cubes
+                glBindVertexArray(cubeVAO);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, cubeTexture);
+                model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
+                shader.setMat4("model", model);
+                shader.setMat3("normalMatrix", NormalMatrix::FromModel(model));
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+
+                glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
+                glStencilMask(0x00);
+                glDisable(GL_DEPTH_TEST);
+          //      singleShader.use();
+
+          //      // cubes
+          //      model = glm::mat4(1.0f);
+          //      model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
+          //      model = glm::scale(model, glm::vec3(1.1f,1.1f, 1.1f));
+          //      singleShader.setMat4("model", model);
+          //      glDrawArrays(GL_TRIANGLES, 0, 36);
+
+                glStencilFunc(GL_ALWAYS, 1, 0xff);
+                glStencilMask(0xff);
+                glEnable(GL_DEPTH_TEST);
+                glClear(GL_STENCIL_BUFFER_BIT);
+
+                shader.use();
+                model = glm::mat4(1.0f);
+                model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
+                shader.setMat4("model", model);
+                shader.setMat3("normalMatrix", NormalMatrix::FromModel(model));
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+
+                glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
+                glStencilMask(0x00);
+                glDisable(GL_DEPTH_TEST);
+
+             /*   singleShader.use();
+                model = glm::mat4(1.0f);
+                model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
+                model = glm::scale(model, glm::vec3(1.1f, 1.1f, 1.1f));
+                singleShader.setMat4("model", model);
+                singleShader.setMat3("normalMatrix", NormalMatrix::FromModel(model));
+                glDrawArrays(GL_TRIANGLES, 0, 36);*/
+
+                glStencilMask(0xFF);
+                glStencilFunc(GL_ALWAYS, 0, 0xFF);
+                glEnable(GL_DEPTH_TEST);
+
+                // vegetation
+                shader.use();
+                glBindVertexArray(vegetationVAO);
+                glBindTexture(GL_TEXTURE_2D, windowTexture);
+                for (map<float, glm::vec3>::reverse_iterator it = sortedWindows.rbegin(); it != sortedWindows.rend(); ++it)
+                {
+                    model = glm::mat4(1.0f);
+                    model = glm::translate(model, it->second);
+                    shader.setMat4("model", model);
+                    shader.setMat3("normalMatrix", NormalMatrix::FromModel(model));
+                    glDrawArrays(GL_TRIANGLES, 0, 6);
+                }
+            });
+
+        graph.AddPass("skybox",
+            [&](FrameGraph::PassBuilder& pass) { pass.Write(scene); },
+            [&]() {
+                // the skybox sits exactly on the far plane, let it pass where nothing was drawn
+                glDepthFunc(ReverseZ::DepthFuncOrEqual());
+                skyboxShader.use();
+                view = glm::mat4(glm::mat3(camera.GetViewMatirx()));
+                projection = ReverseZ::Perspective(glm::radians(camera.Fov), aspect, 0.1f, 100.0f);
+                skyboxShader.setMat4("view", view);
+                skyboxShader.setMat4("projection", projection);
+                glBindVertexArray(skyboxVAO);
+                glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+
+                glDepthFunc(ReverseZ::DepthFunc());
+            });
+
+        graph.AddPass("post",
+            [&](FrameGraph::PassBuilder& pass) {
+                // the scene's color attachment is the texture of the quad plane
+                pass.Read(scene, 0);
+                pass.Write(FrameGraph::BACKBUFFER);
+            },
+            [&]() {
+                glDisable(GL_DEPTH_TEST);
+                glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT);
+
+                screenShader.use();
+                glBindVertexArray(quadVAO);
+                //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+            });
+        graph.Execute();
+        // swap buffers and poll IO events, or record the frame when headless
+        // -------------------------------------------------------------------
+        runner.EndFrame();
     }
 
     // optional: de-allocate all resources once they've outlived their purpose:
@@ -469,8 +477,7 @@ int main()
     glDeleteBuffers(1, &cubeVBO);
     glDeleteBuffers(1, &planeVBO);
 
-    glfwTerminate();
-    return 0;
+    return runner.ExitCode();
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
@@ -533,6 +540,7 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 // ---------------------------------------------------
 unsigned int loadTexture(const char* path)
 {
+    GPU_MEMORY_OWNER("texture");
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
@@ -578,6 +586,7 @@ unsigned int loadTexture(const char* path)
 
 unsigned int loadCubeTextrue(vector<string> cubePaths)
 {
+    GPU_MEMORY_OWNER("skybox");
     unsigned int textureID;
     glGenTextures(1, &textureID);
     glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
@@ -5,6 +5,8 @@
 #include "camera.h"
 #include "model.h"
 #include "shader.h"
+#include "demorunner.h"
+#include "framegraph.h"
 using namespace std;
 
 
@@ -27,35 +29,16 @@ glm::vec3 lightPos(1.2f, 10.0f, -10.0f);
 
 int main()
 {
-    // glfw: initialize and configure
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    //glfwWindowHint(GLFW_SAMPLES, 4);
-
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-
-    // glfw window creation
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    if (window == NULL)
-    {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
+    // context and frame loop, headless with LOGL_HEADLESS (demorunner.h)
+    DemoRunner runner("taa", SCR_WIDTH, SCR_HEIGHT);
+    if (!runner.Ok())
         return -1;
-    }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-
-    // glad: load all OpenGL function pointers
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    GLFWwindow* window = runner.Window();
+    if (runner.Interactive())
     {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
     }
 
     const glm::vec2 Halton_2_3[8] =
@@ -74,7 +57,8 @@ int main()
 
     // Setup and compile our shaders
     Shader shader("vs_taa.vert", "fs_taa.frag");
-    Shader screenShader("vs_taa.vert", "fs_taa.frag");
+    Shader resolveShader("vs_framebuffer.vert", "fs_taa_resolve.frag");
+    ShaderBinaryCache::PrintStats();
 
 #pragma region "object_initialization"
     // Set the object data (buffers, vertex attributes)
@@ -158,100 +142,140 @@ int main()
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
 #pragma endregion
 
-    unsigned int framebuffer;
-    glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-
-    unsigned int textureColorbuffer;
-    glGenTextures(1, &textureColorbuffer);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, textureColorbuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureColorbuffer, 0);
-
-    unsigned int rbo;
-    glGenRenderbuffers(1, &rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT); // use a single renderbuffer object for both a depth AND stencil buffer.
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo); // now actually attach it
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    unsigned int windowTexture = loadTexture("resources/textures/container.jpg");
+
+    GLTexture windowTexture(loadTexture("resources/textures/container.jpg"));
 
     glEnable(GL_DEPTH_TEST);
 
-    screenShader.use();
-    screenShader.setInt("screenTexture", 0);
-    screenShader.setInt("windowTexture", 1);
-    shader.setBool("useTexture", true);
+    resolveShader.use();
+    resolveShader.setInt("currentTexture", 0);
+    resolveShader.setInt("historyTexture", 1);
+    resolveShader.setInt("velocityTexture", 2);
+    resolveShader.setInt("depthTexture", 3);
+    resolveShader.setFloat("blendFactor", 0.1f);
     shader.use();
-    shader.setBool("useTexture", false);
-    shader.setBool("firstDraw", false);
     shader.setInt("windowTexture", 1);
 
+    // scene -> resolve -> present, the resolve reads last frame's history and writes
+    // this frame's, the two targets swap every frame
+    FrameGraph graph(runner.Targets());
+    std::unique_ptr<RenderTarget> history[2];
+    bool historyValid = false;
+    glm::mat4 previousViewProjection;
     unsigned int index = 0;
     // Game loop
-    while (!glfwWindowShouldClose(window))
+    while (runner.Running())
     {
         // Set frame time
-        GLfloat currentFrame = glfwGetTime();
+        GLfloat currentFrame = runner.Time();
         deltaTime = currentFrame - lastTime;
         lastTime = currentFrame;
 
         // Check and call events
-        processInput(window);
-
-        // Clear buffers
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, windowTexture);
-
-        screenShader.use();
-        glm::mat4 projection = glm::perspective(camera.Fov, (GLfloat)SCR_WIDTH / (GLfloat)SCR_HEIGHT, 0.1f, 1000.0f);
-        projection[2][0] += (Halton_2_3[(index++ % 8)].x) / SCR_WIDTH;
-        projection[2][1] += (Halton_2_3[index++ % 8].y) / SCR_HEIGHT;
-        glUniformMatrix4fv(glGetUniformLocation(screenShader.ID, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-        glUniformMatrix4fv(glGetUniformLocation(screenShader.ID, "view"), 1, GL_FALSE, glm::value_ptr(camera.GetViewMatirx()));
+        runner.UpdateCamera(camera);
+        if (runner.Interactive())
+            processInput(window);
+
+        int framebufferWidth, framebufferHeight;
+        runner.FramebufferSize(&framebufferWidth, &framebufferHeight);
+        if (framebufferWidth == 0 || framebufferHeight == 0)
+        {
+            runner.EndFrame();
+            continue;
+        }
+        graph.SetBackbufferSize(framebufferWidth, framebufferHeight);
+
+        if (!history[0] || history[0]->Desc.Width != framebufferWidth || history[0]->Desc.Height != framebufferHeight)
+        {
+            RenderTargetDesc historyDesc;
+            historyDesc.Width = framebufferWidth;
+            historyDesc.Height = framebufferHeight;
+            historyDesc.ColorFormat = GL_RGBA16F;
+            historyDesc.DepthFormat = 0;
+            history[0] = RenderTargetPool::Create(historyDesc);
+            history[1] = RenderTargetPool::Create(historyDesc);
+            historyValid = false;
+        }
+
+        // sub-pixel jitter, Halton_2_3 spans one pixel
+        glm::vec2 jitter = Halton_2_3[index % 8];
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Fov), (GLfloat)framebufferWidth / (GLfloat)framebufferHeight, 0.1f, 1000.0f);
+        glm::mat4 viewProjection = projection * camera.GetViewMatirx();
+        if (!historyValid)
+            previousViewProjection = viewProjection;
+        projection[2][0] += jitter.x / framebufferWidth;
+        projection[2][1] += jitter.y / framebufferHeight;
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::scale(model, glm::vec3(8.0f, 8.0f, 8.0f));
-        screenShader.setMat4("model", model);
-        screenShader.setBool("firstDraw", index == 1);
-
-        glBindVertexArray(cubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-        // Clear buffers
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Set transformation matrices		
-        shader.use();
-        glUniformMatrix4fv(glGetUniformLocation(shader.ID, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-        glUniformMatrix4fv(glGetUniformLocation(shader.ID, "view"), 1, GL_FALSE, glm::value_ptr(camera.GetViewMatirx()));
-        shader.setMat4("model", model);
-
-        glBindVertexArray(cubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        RenderTargetDesc sceneDesc;
+        sceneDesc.Width = framebufferWidth;
+        sceneDesc.Height = framebufferHeight;
+        sceneDesc.SampledDepth = true;
+        sceneDesc.VelocityFormat = GL_RG16F;
+        FrameGraph::Resource scene = 0;
+        FrameGraph::Resource previousHistory = graph.Import("previous history", *history[index % 2]);
+        FrameGraph::Resource currentHistory = graph.Import("history", *history[(index + 1) % 2]);
+
+        graph.AddPass("scene", [&](FrameGraph::PassBuilder& builder) {
+            scene = builder.Create("scene", sceneDesc);
+        }, [&]() {
+            // Clear buffers, the background does not move
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            const GLfloat noMotion[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            glClearBufferfv(GL_COLOR, 1, noMotion);
+
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, windowTexture);
+
+            // Set transformation matrices
+            shader.use();
+            shader.setMat4("projection", projection);
+            shader.setMat4("view", camera.GetViewMatirx());
+            shader.setMat4("model", model);
+            shader.setMat4("viewProjection", viewProjection);
+            shader.setMat4("previousModel", model);
+            shader.setMat4("previousViewProjection", previousViewProjection);
+
+            glBindVertexArray(cubeVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+            glBindVertexArray(0);
+        });
+        graph.AddPass("resolve", [&](FrameGraph::PassBuilder& builder) {
+            builder.Read(scene, 0);
+            builder.Read(previousHistory, 1);
+            builder.Read(scene, 2, FrameGraph::VELOCITY);
+            builder.Read(scene, 3, FrameGraph::DEPTH);
+            builder.Write(currentHistory);
+        }, [&]() {
+            glDisable(GL_DEPTH_TEST);
+            resolveShader.use();
+            resolveShader.setBool("historyValid", historyValid);
+            glBindVertexArray(quadVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            glBindVertexArray(0);
+            glEnable(GL_DEPTH_TEST);
+        });
+        graph.AddPass("present", [&](FrameGraph::PassBuilder& builder) {
+            builder.Read(currentHistory);
+            builder.Write(FrameGraph::BACKBUFFER);
+        }, [&]() {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, graph.Target(currentHistory).FBO);
+            glBlitFramebuffer(0, 0, framebufferWidth, framebufferHeight, 0, 0, framebufferWidth, framebufferHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        });
+        graph.Execute();
+
+        historyValid = true;
+        previousViewProjection = viewProjection;
+        index++;
 
         // Swap the buffers
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        runner.EndFrame();
     }
 
-
-    glfwTerminate();
-    return 0;
+    return runner.ExitCode();
 }
 
 void processInput(GLFWwindow* window)
@@ -305,6 +329,7 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 
 unsigned int loadTexture(char const* path)
 {
+    GPU_MEMORY_OWNER("texture");
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
@@ -5,6 +5,17 @@
 #include "camera.h"
 #include "model.h"
 #include "shader.h"
+#include "shaderregistry.h"
+#include "cascadedshadows.h"
+#include "staticshadowcache.h"
+#include "gputimer.h"
+#include "normalmatrix.h"
+#include "reversez.h"
+#include "maskedocclusion.h"
+#include "demorunner.h"
+#include "gpuprofiler.h"
+#include "framegraph.h"
+#include <vector>
 using namespace std;
 
 
@@ -12,8 +23,24 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 unsigned int loadTexture(char const* path);
 
+// a draw of the scene, also a shadow caster with a world space bounding box
+struct SceneObject {
+    glm::mat4 Model;
+    unsigned int VAO;
+    unsigned int DepthVAO;  // position-only stream for the shadow pass
+    int VertexCount;
+    const float* Vertices;  // interleaved position, normal, uv, for the software occlusion culler
+    glm::vec3 LocalMin, LocalMax;
+    bool Static;        // never moves on its own, its shadow can be cached
+};
+ShadowCaster worldBounds(const SceneObject& object);
+void renderScene(Shader& shader, const vector<SceneObject>& objects, const vector<unsigned int>* subset = nullptr, bool depthOnly = false);
+GLVertexArray createPositionVAO(const float* vertices, int vertexCount, int stride, GLBuffer& positionBuffer);
+vector<unsigned int> filterCasters(const vector<SceneObject>& objects, const vector<unsigned int>& casters, bool isStatic);
+
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
@@ -25,45 +52,54 @@ Camera camera(glm::vec3(1.0f, 5.0f, -22.0f));
 
 glm::vec3 lightPos(1.2f, 10.0f, -10.0f);
 
+// 'C' toggles the static shadow cache, the arrow keys turn the light, 'M' moves a static cube
+bool shadowCaching = true;
+bool moveStaticCube = false;
+
+// 'O' toggles CPU occlusion culling of the lit pass' draws
+bool occlusionCulling = true;
+
+// 'F' cycles the shadow filter kernel (SHADOW_FILTER in fs_depth.frag)
+const int SHADOW_FILTER_COUNT = 3;
+const char* SHADOW_FILTER_NAMES[SHADOW_FILTER_COUNT] = { "hardware 2x2 PCF", "3x3 hardware PCF", "rotated Poisson 12 taps" };
+int shadowFilter = 0;
+float lightAngle = 0.0f;
+
 int main()
 {
-    // glfw: initialize and configure
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    //glfwWindowHint(GLFW_SAMPLES, 4);
-
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-
-    // glfw window creation
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    if (window == NULL)
-    {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
+    // context and frame loop, headless with LOGL_HEADLESS (demorunner.h)
+    DemoRunner runner("shadows", SCR_WIDTH, SCR_HEIGHT);
+    if (!runner.Ok())
         return -1;
-    }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-
-    // glad: load all OpenGL function pointers
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    GLFWwindow* window = runner.Window();
+    if (runner.Interactive())
     {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetKeyCallback(window, key_callback);
     }
 
     glEnable(GL_DEPTH_TEST);
+    // reversed depth for the camera and the shadow cascades alike
+    ReverseZ::Enable();
 
     // build and compile shaders
     // -------------------------
-    Shader simpleDepthShader("vs_depthmap.vert", "fs_depthmap.frag");
-    Shader shader("vs_depth.vert", "fs_depth.frag");
+    // shaders reload when their files (or includes) are saved
+    ShaderRegistry shaderRegistry;
+    Shader& simpleDepthShader = shaderRegistry.Load("vs_depthmap.vert", "fs_depthmap.frag");
+    // one permutation per shadow kernel. Every object only rotates, translates and
+    // scales uniformly, so mat3(model) maps the normals and none is uploaded.
+    Shader* litShaders[SHADOW_FILTER_COUNT];
+    for (int i = 0; i < SHADOW_FILTER_COUNT; i++)
+    {
+        litShaders[i] = &shaderRegistry.Load("vs_depth.vert", "fs_depth.frag", nullptr, ReverseZ::Defines(ShaderDefines().Set("SHADOW_FILTER", i).Set("NORMAL_MATRIX", 0)), [](Shader& s) {
+            s.setInt("diffuseTexture", 0);
+            s.setInt("shadowMap", 1);
+        });
+    }
+    ShaderBinaryCache::PrintStats();
 
     float vertices[] = {
         // back face
@@ -176,166 +212,212 @@ int main()
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
     glBindVertexArray(0);
 
+    // position-only copies for the shadow pass: 12 instead of 32 bytes fetched per vertex
+    GLBuffer cubePositions, planePositions;
+    GLVertexArray cubeDepthVAO = createPositionVAO(vertices, 36, 8, cubePositions);
+    GLVertexArray planeDepthVAO = createPositionVAO(planeVertices, 6, 8, planePositions);
+
     // load textures
     // -------------
-    unsigned int woodTexture = loadTexture("resources/textures/wood.png");
-
-    // configure depth map FBO
-    // -----------------------
-    const unsigned int SHADOW_WIDTH = 1024, SHADOW_HEIGHT = 1024;
-    unsigned int depthMapFBO;
-    glGenFramebuffers(1, &depthMapFBO);
-    // create depth texture
-    unsigned int depthMap;
-    glGenTextures(1, &depthMap);
-    glBindTexture(GL_TEXTURE_2D, depthMap);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // attach depth texture as FBO's depth buffer
-    glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-
-    // shader configuration
-    // --------------------
-    shader.use();
-    shader.setInt("diffuseTexture", 0);
-    shader.setInt("shadowMap", 1);
+    GLTexture woodTexture(loadTexture("resources/textures/wood.png"));
+
+    // scene: the floor and three cubes
+    // --------------------------------
+    vector<SceneObject> objects;
+    SceneObject ground = { glm::mat4(1.0f), planeVAO, planeDepthVAO, 6, planeVertices, glm::vec3(-25.0f, -0.5f, -25.0f), glm::vec3(25.0f, -0.5f, 25.0f), true };
+    objects.push_back(ground);
+    SceneObject cube = { glm::mat4(1.0f), cubeVAO, cubeDepthVAO, 36, vertices, glm::vec3(-1.0f), glm::vec3(1.0f), true };
+    cube.Model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 1.5f, 0.0));
+    cube.Model = glm::scale(cube.Model, glm::vec3(0.5f));
+    objects.push_back(cube);
+    cube.Model = glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, 0.0f, 1.0));
+    cube.Model = glm::scale(cube.Model, glm::vec3(0.5f));
+    objects.push_back(cube);
+    cube.Model = glm::translate(glm::mat4(1.0f), glm::vec3(-1.0f, 0.0f, 2.0));
+    cube.Model = glm::rotate(cube.Model, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
+    cube.Model = glm::scale(cube.Model, glm::vec3(0.25));
+    objects.push_back(cube);
+    // a small cube circling the others, the only dynamic caster
+    unsigned int orbiterIndex = (unsigned int)objects.size();
+    cube.Static = false;
+    objects.push_back(cube);
+    for (unsigned int i = 0; i < objects.size(); i++)
+    {
+        if (!NormalMatrix::HasUniformScale(objects[i].Model))
+            cout << "WARNING::SCENE:: object " << i << " scales non-uniformly, the NORMAL_MATRIX 0 shaders skew its normals" << endl;
+    }
+
+    vector<ShadowCaster> casters;
+    for (unsigned int i = 0; i < objects.size(); i++)
+        casters.push_back(worldBounds(objects[i]));
+
+    // cascaded shadow maps: 3 layers of 2048x2048
+    // --------------------------------------------
+    CascadedShadowMap shadowMap(3, 2048);
+    StaticShadowCache shadowCache(shadowMap);
+
+    // GPU time of the lit pass per shadow kernel, printed every KERNEL_REPORT_FRAMES frames
+    GpuTimer litPassTimers[SHADOW_FILTER_COUNT];
+    const unsigned int KERNEL_REPORT_FRAMES = 300;
+    unsigned int frameCount = 0;
+
+    // CPU occlusion culling at 256x128
+    MaskedOcclusionCulling occlusion(256, 128);
+    vector<unsigned int> unoccluded;
 
     // lighting info
     // -------------
-    glm::vec3 lightPos(-2.0f, 4.0f, -1.0f);
+    const glm::vec3 initialLightPos(-2.0f, 4.0f, -1.0f);
+
+    // shadow -> lit, re-declared every frame
+    FrameGraph graph(runner.Targets());
 
     // render loop
     // -----------
-    while (!glfwWindowShouldClose(window))
+    while (runner.Running())
     {
         // per-frame time logic
         // --------------------
-        float currentFrame = static_cast<float>(glfwGetTime());
+        float currentFrame = runner.Time();
         deltaTime = currentFrame - lastTime;
         lastTime = currentFrame;
 
         // input
         // -----
-        processInput(window);
+        runner.UpdateCamera(camera);
+        if (runner.Interactive())
+            processInput(window);
+        shaderRegistry.Update();
 
         // render
         // ------
+        // the lit pass, the projection and the cascade fit all follow the framebuffer size
+        int width, height;
+        runner.FramebufferSize(&width, &height);
+        if (width == 0 || height == 0)
+        {
+            runner.EndFrame();
+            continue;
+        }
+        float aspect = (float)width / (float)height;
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // 1. render depth of scene to texture (from light's perspective)
-        // --------------------------------------------------------------
-        glm::mat4 lightProjection, lightView;
-        glm::mat4 lightSpaceMatrix;
-        float near_plane = 1.0f, far_plane = 7.5f;
-        lightProjection = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, near_plane, far_plane);
-        lightView = glm::lookAt(lightPos, glm::vec3(0.0f), glm::vec3(0.0, 1.0, 0.0));
-        lightSpaceMatrix = lightProjection * lightView;
-        // render scene from light's point of view
-        simpleDepthShader.use();
-        simpleDepthShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-        glClear(GL_DEPTH_BUFFER_BIT);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, woodTexture);
-        // floor
-        glm::mat4 model = glm::mat4(1.0f);
-        simpleDepthShader.setMat4("model", model);
-        glBindVertexArray(planeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        // cubes
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, 1.5f, 0.0));
-        model = glm::scale(model, glm::vec3(0.5f));
-        simpleDepthShader.setMat4("model", model);
-        // render Cube
-        glBindVertexArray(cubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(2.0f, 0.0f, 1.0));
-        model = glm::scale(model, glm::vec3(0.5f));
-        simpleDepthShader.setMat4("model", model);
-        // render Cube
-        glBindVertexArray(cubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-1.0f, 0.0f, 2.0));
-        model = glm::rotate(model, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
-        model = glm::scale(model, glm::vec3(0.25));
-        simpleDepthShader.setMat4("model", model);
-        // render Cube
-        glBindVertexArray(cubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-        // reset viewport
-        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // render Depth map to quad for visual debugging
-        // ---------------------------------------------
-        shader.use();
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Fov), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        graph.SetBackbufferSize(width, height);
+
+        glm::mat4 projection = ReverseZ::Perspective(glm::radians(camera.Fov), aspect, 0.1f, 100.0f);
         glm::mat4 view = camera.GetViewMatirx();
-        shader.setMat4("projection", projection);
-        shader.setMat4("view", view);
-        // set light uniforms
-        shader.setVec3("viewPos", camera.Position);
-        shader.setVec3("lightPos", lightPos);
-        shader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, woodTexture);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, depthMap);
-        // floor
-        model = glm::mat4(1.0f);
-        shader.setMat4("model", model);
-        glBindVertexArray(planeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        // cubes
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, 1.5f, 0.0));
-        model = glm::scale(model, glm::vec3(0.5f));
-        shader.setMat4("model", model);
-        // render Cube
-        glBindVertexArray(cubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(2.0f, 0.0f, 1.0));
-        model = glm::scale(model, glm::vec3(0.5f));
-        shader.setMat4("model", model);
-        // render Cube
-        glBindVertexArray(cubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-1.0f, 0.0f, 2.0));
-        model = glm::rotate(model, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
-        model = glm::scale(model, glm::vec3(0.25));
-        shader.setMat4("model", model);
-        // render Cube
-        glBindVertexArray(cubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        glm::vec3 lightPos = glm::vec3(glm::rotate(glm::mat4(1.0f), lightAngle, glm::vec3(0.0f, 1.0f, 0.0f)) * glm::vec4(initialLightPos, 1.0f));
+
+        // animate the dynamic caster
+        glm::mat4 orbit = glm::rotate(glm::mat4(1.0f), currentFrame, glm::vec3(0.0f, 1.0f, 0.0f));
+        orbit = glm::translate(orbit, glm::vec3(3.0f, 1.0f + 0.5f * sin(currentFrame * 2.0f), 0.0f));
+        objects[orbiterIndex].Model = glm::scale(orbit, glm::vec3(0.3f));
+        casters[orbiterIndex] = worldBounds(objects[orbiterIndex]);
+
+        // moving a static object only invalidates the cascades it covered before and after
+        if (moveStaticCube)
+        {
+            shadowCache.InvalidateBounds(casters[2]);
+            objects[2].Model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 0.5f)) * objects[2].Model;
+            casters[2] = worldBounds(objects[2]);
+            shadowCache.InvalidateBounds(casters[2]);
+            moveStaticCube = false;
+        }
+
+        // 1. render depth of scene to every cascade (from light's perspective)
+        // --------------------------------------------------------------------
+        // the light shines from lightPos towards the origin
+        FrameGraph::Resource cascades = graph.Import("shadow cascades", shadowMap.DepthArray, GL_TEXTURE_2D_ARRAY);
+        graph.AddPass("shadow",
+            [&](FrameGraph::PassBuilder& pass) { pass.Write(cascades); },
+            [&]() {
+                shadowMap.SetQuantizedPlacement(shadowCaching);
+                shadowMap.Update(view, glm::radians(camera.Fov), aspect, 0.1f, 100.0f, -lightPos, casters);
+                if (shadowCaching)
+                {
+                    // a layer whose matrix did not change reuses its static depth, only the orbiter is drawn
+                    shadowCache.Render(shadowMap, simpleDepthShader,
+                        [&](int c) {
+                            vector<unsigned int> visible = filterCasters(objects, shadowMap.GetCascade(c).Casters, true);
+                            renderScene(simpleDepthShader, objects, &visible, true);
+                        },
+                        [&](int c) {
+                            vector<unsigned int> visible = filterCasters(objects, shadowMap.GetCascade(c).Casters, false);
+                            renderScene(simpleDepthShader, objects, &visible, true);
+                        });
+                    unsigned int redraws = shadowCache.TakeStaticRedraws();
+                    if (redraws > 0)
+                        cout << "SHADOW::CACHE redrew " << redraws << " static cascade(s)" << endl;
+                }
+                else
+                {
+                    simpleDepthShader.use();
+                    for (int i = 0; i < shadowMap.CascadeCount(); i++)
+                    {
+                        shadowMap.BeginCascade(i);
+                        simpleDepthShader.setMat4("lightSpaceMatrix", shadowMap.GetCascade(i).LightSpaceMatrix);
+                        renderScene(simpleDepthShader, objects, &shadowMap.GetCascade(i).Casters, true);
+                    }
+                    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                }
+            });
+
+        // 2. render scene as normal using the cascades
+        // --------------------------------------------
+        graph.AddPass("lit",
+            [&](FrameGraph::PassBuilder& pass) {
+                // shadowMap.Bind samples the cascades along with their matrices
+                pass.Read(cascades);
+                pass.Write(FrameGraph::BACKBUFFER);
+            },
+            [&]() {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                Shader& shader = *litShaders[shadowFilter];
+                litPassTimers[shadowFilter].Begin();
+                shader.use();
+                shader.setMat4("projection", projection);
+                shader.setMat4("view", view);
+                // set light uniforms
+                shader.setVec3("viewPos", camera.Position);
+                shader.setVec3("lightPos", lightPos);
+                shadowMap.Bind(shader, 1);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, woodTexture);
+                if (occlusionCulling)
+                {
+                    // the floor and the static cubes are the occluders, casters holds every object's world bounds
+                    {
+                        PROFILE_CPU("occlusion");
+                        occlusion.Clear(projection * view, 0.1f);
+                        for (unsigned int i = 0; i < objects.size(); i++)
+                        {
+                            if (objects[i].Static)
+                                occlusion.RenderOccluder(objects[i].Model, objects[i].Vertices, 8 * sizeof(float), nullptr, objects[i].VertexCount / 3);
+                        }
+                        unoccluded.clear();
+                        for (unsigned int i = 0; i < objects.size(); i++)
+                        {
+                            if (occlusion.IsVisible(casters[i].BoundsMin, casters[i].BoundsMax))
+                                unoccluded.push_back(i);
+                        }
+                    }
+                    renderScene(shader, objects, &unoccluded);
+                }
+                else
+                    renderScene(shader, objects);
+                litPassTimers[shadowFilter].End();
+            });
+        graph.Execute();
+
+        if (++frameCount % KERNEL_REPORT_FRAMES == 0)
+        {
+            cout << "SHADOW::FILTER " << SHADOW_FILTER_NAMES[shadowFilter] << ": lit pass " << litPassTimers[shadowFilter].TakeAverageMs() << " ms GPU" << endl;
+            if (occlusionCulling)
+                cout << "OCCLUSION:: culled " << occlusion.Culled() << " of " << occlusion.Tested() << " draws, " << occlusion.OccluderTriangles() << " occluder triangles in " << occlusion.RasterMs() << " ms" << endl;
+        }
+
+        // swap buffers and poll IO events, or record the frame when headless
+        // -------------------------------------------------------------------
+        runner.EndFrame();
     }
 
     // optional: de-allocate all resources once they've outlived their purpose:
@@ -343,8 +425,69 @@ int main()
     glDeleteVertexArrays(1, &planeVAO);
     glDeleteBuffers(1, &planeVBO);
 
-    glfwTerminate();
-    return 0;
+    return runner.ExitCode() != 0 || shaderRegistry.ReloadCheckFailed() ? 1 : 0;
+}
+
+ShadowCaster worldBounds(const SceneObject& object)
+{
+    ShadowCaster bounds = { glm::vec3(1e30f), glm::vec3(-1e30f), !object.Static };
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec3 corner((i & 1) ? object.LocalMax.x : object.LocalMin.x, (i & 2) ? object.LocalMax.y : object.LocalMin.y, (i & 4) ? object.LocalMax.z : object.LocalMin.z);
+        glm::vec3 world = glm::vec3(object.Model * glm::vec4(corner, 1.0f));
+        bounds.BoundsMin = glm::min(bounds.BoundsMin, world);
+        bounds.BoundsMax = glm::max(bounds.BoundsMax, world);
+    }
+    return bounds;
+}
+
+// draws all objects, or only the listed ones. depthOnly passes fetch only positions.
+void renderScene(Shader& shader, const vector<SceneObject>& objects, const vector<unsigned int>* subset, bool depthOnly)
+{
+    unsigned int count = subset != nullptr ? (unsigned int)subset->size() : (unsigned int)objects.size();
+    for (unsigned int i = 0; i < count; i++)
+    {
+        const SceneObject& object = objects[subset != nullptr ? (*subset)[i] : i];
+        shader.setMat4("model", object.Model);
+        glBindVertexArray(depthOnly ? object.DepthVAO : object.VAO);
+        glDrawArrays(GL_TRIANGLES, 0, object.VertexCount);
+    }
+    glBindVertexArray(0);
+}
+
+vector<unsigned int> filterCasters(const vector<SceneObject>& objects, const vector<unsigned int>& casters, bool isStatic)
+{
+    vector<unsigned int> result;
+    for (unsigned int i = 0; i < casters.size(); i++)
+    {
+        if (objects[casters[i]].Static == isStatic)
+            result.push_back(casters[i]);
+    }
+    return result;
+}
+
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    if (action != GLFW_PRESS)
+        return;
+
+    if (key == GLFW_KEY_C)
+    {
+        shadowCaching = !shadowCaching;
+        cout << "SHADOW::CACHE " << (shadowCaching ? "on" : "off") << endl;
+    }
+    if (key == GLFW_KEY_M)
+        moveStaticCube = true;
+    if (key == GLFW_KEY_O)
+    {
+        occlusionCulling = !occlusionCulling;
+        cout << "OCCLUSION " << (occlusionCulling ? "on" : "off") << endl;
+    }
+    if (key == GLFW_KEY_F)
+    {
+        shadowFilter = (shadowFilter + 1) % SHADOW_FILTER_COUNT;
+        cout << "SHADOW::FILTER " << SHADOW_FILTER_NAMES[shadowFilter] << endl;
+    }
 }
 
 void processInput(GLFWwindow* window)
@@ -362,6 +505,11 @@ void processInput(GLFWwindow* window)
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.KeyBoradCallBack(RIGHT, deltaTime);
 
+    if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
+        lightAngle += deltaTime;
+    if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
+        lightAngle -= deltaTime;
+
     if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)
         cout << "CAMERA POSITION: " + to_string(camera.Position.x) + "      " + to_string(camera.Position.y) + "      " + to_string(camera.Position.z);
 }
@@ -398,6 +546,7 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 
 unsigned int loadTexture(char const* path)
 {
+    GPU_MEMORY_OWNER("texture");
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
@@ -431,4 +580,26 @@ unsigned int loadTexture(char const* path)
     }
 
     return textureID;
-}
\ No newline at end of file
+}
+
+// copies the leading vec3 of every interleaved vertex into positionBuffer and a VAO reading it (attribute 0)
+GLVertexArray createPositionVAO(const float* vertices, int vertexCount, int stride, GLBuffer& positionBuffer)
+{
+    vector<float> positions(vertexCount * 3);
+    for (int i = 0; i < vertexCount; i++)
+    {
+        positions[i * 3] = vertices[i * stride];
+        positions[i * 3 + 1] = vertices[i * stride + 1];
+        positions[i * 3 + 2] = vertices[i * stride + 2];
+    }
+
+    GLVertexArray VAO = GLVertexArray::Create();
+    positionBuffer = GLBuffer::Create();
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), &positions[0], GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glBindVertexArray(0);
+    return VAO;
+}
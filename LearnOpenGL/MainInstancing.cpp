@@ -5,6 +5,13 @@
 #include "camera.h"
 #include "model.h"
 #include "shader.h"
+#include "normalmatrix.h"
+#include "reversez.h"
+#include "hizculling.h"
+#include "demorunner.h"
+#include <vector>
+#include <string>
+#include <cstdlib>
 using namespace std;
 
 
@@ -27,38 +34,26 @@ glm::vec3 lightPos(1.2f, 10.0f, -10.0f);
 
 int main()
 {
-    // glfw: initialize and configure
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-
-    // glfw window creation
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    if (window == NULL)
-    {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
+    // context and frame loop, headless with LOGL_HEADLESS (demorunner.h)
+    DemoRunner runner("instancing", SCR_WIDTH, SCR_HEIGHT);
+    if (!runner.Ok())
         return -1;
-    }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-
-    // glad: load all OpenGL function pointers
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    GLFWwindow* window = runner.Window();
+    if (runner.Interactive())
     {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
     }
 
-    // build and compile our shader zprogram
-    Shader shader("vs_instancing.vert", "fs_instancing.frag");
+    // the belt spans 0.1 to 1000 units: reversed float depth keeps the far asteroids apart.
+    // the window's depth buffer is fixed point, so the scene renders into its own target
+    ReverseZ::Enable();
+    // RGBA8 color and 32-bit float depth in a texture, the Hi-Z pyramid is built from it
+    RenderTargetDesc sceneDesc;
+    sceneDesc.ColorFormat = GL_RGBA8;
+    sceneDesc.DepthFormat = GL_DEPTH_COMPONENT32F;
+    sceneDesc.SampledDepth = true;
 
     Model planet("resources/objects/hutao/hutao.obj");
 
@@ -67,7 +62,7 @@ int main()
     unsigned int amount = 10000;
     glm::mat4* modelMatrices;
     modelMatrices = new glm::mat4[amount];
-    srand(static_cast<unsigned int>(glfwGetTime())); // initialize random seed
+    srand(static_cast<unsigned int>(runner.Time())); // initialize random seed, fixed when headless
     float radius = 50.0;
     float offset = 2.5f;
     for (unsigned int i = 0; i < amount; i++)
@@ -81,9 +76,11 @@ int main()
         float z = cos(angle) * radius + displacement;
         model = glm::translate(model, glm::vec3(x, y, z));
 
-        // 2. scale: Scale between 0.05 and 0.25f
+        // 2. scale: Scale between 0.05 and 0.25f, every fourth asteroid flattened to between 40% and 100% of
+        //    that on one axis, so the normal matrices are needed and come from NormalMatrix::ComputeBatch
         float scale = static_cast<float>((rand() % 20) / 100.0 + 0.05);
-        model = glm::scale(model, glm::vec3(scale));
+        float flatten = i % 4 == 0 ? static_cast<float>((rand() % 60) / 100.0 + 0.4) : 1.0f;
+        model = glm::scale(model, glm::vec3(scale, scale * flatten, scale));
 
         // 3. rotation: add random rotation around a (semi)randomly picked rotation axis vector
         float rotAngle = static_cast<float>((rand() % 360));
@@ -92,11 +89,48 @@ int main()
         // 4. now add to list of matrices
         modelMatrices[i] = model;
     }
+    // the planet in the middle of the belt, drawn on its own, hides the asteroids behind it
+    glm::mat4 planetModel = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -3.0f, 0.0f)), glm::vec3(4.0f));
+    glm::mat3 planetNormalMatrix = NormalMatrix::FromModel(planetModel);
 
+    // model space bounds shared by all instances, for the occlusion test
+    glm::vec3 localMin(1e30f), localMax(-1e30f);
+    for (unsigned int i = 0; i < planet.meshes.size(); i++)
+    {
+        for (unsigned int j = 0; j < planet.meshes[i].vertices.size(); j++)
+        {
+            localMin = glm::min(localMin, planet.meshes[i].vertices[j].Position);
+            localMax = glm::max(localMax, planet.meshes[i].vertices[j].Position);
+        }
+    }
+
+    // normal matrices: none when every instance scales uniformly, otherwise
+    // computed once up front and streamed per instance next to the model matrix
+    bool uniformScale = NormalMatrix::AllUniformScale(modelMatrices, amount);
+    ShaderDefines defines;
+    defines.Set("NORMAL_MATRIX", !uniformScale);
+
+    // build and compile our shader zprogram
+    Shader shader("vs_instancing.vert", "fs_instancing.frag", nullptr, defines);
+    ShaderBinaryCache::PrintStats();
+
+    GPU_MEMORY_OWNER("instances");
+    unsigned int normalVBO = 0;
+    glm::mat3* normalMatrices = nullptr;
+    if (!uniformScale)
+    {
+        normalMatrices = new glm::mat3[amount];
+        NormalMatrix::ComputeBatch(modelMatrices, normalMatrices, amount);
+        glGenBuffers(1, &normalVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, normalVBO);
+        glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat3), &normalMatrices[0], GL_STREAM_DRAW);
+    }
+
+    // refilled every frame with the instances that passed occlusion culling
     unsigned int VBO;
     glGenBuffers(1, &VBO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat4), &modelMatrices[0], GL_STREAM_DRAW);
 
     for (unsigned int i = 0; i < planet.meshes.size(); i++)
     {
@@ -115,62 +149,146 @@ int main()
         glVertexAttribDivisor(4, 1);
         glVertexAttribDivisor(5, 1);
         glVertexAttribDivisor(6, 1);
+
+        if (normalVBO != 0)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, normalVBO);
+            for (unsigned int column = 0; column < 3; column++)
+            {
+                glEnableVertexAttribArray(8 + column);
+                glVertexAttribPointer(8 + column, 3, GL_FLOAT, GL_FALSE, sizeof(glm::mat3), (void*)(column * sizeof(glm::vec3)));
+                glVertexAttribDivisor(8 + column, 1);
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        }
         glBindVertexArray(0);
     }
 
+    // occlusion culling against last frame's depth, LOGL_NO_OCCLUSION_CULLING draws everything
+    bool occlusionCulling = getenv("LOGL_NO_OCCLUSION_CULLING") == nullptr;
+    HiZCulling hiZ;
+    vector<unsigned int> visible;
+    vector<glm::mat4> visibleMatrices;
+    vector<glm::mat3> visibleNormalMatrices;
+
     // render loop
     // -----------
-    while (!glfwWindowShouldClose(window))
+    while (runner.Running())
     {
         // per-frame time logic
         // --------------------
-        float currentFrame = static_cast<float>(glfwGetTime());
+        float currentFrame = runner.Time();
         deltaTime = currentFrame - lastTime;
         lastTime = currentFrame;
 
         // input
         // -----
-        processInput(window);
+        runner.UpdateCamera(camera);
+        if (runner.Interactive())
+            processInput(window);
 
         // render
         // ------
+        runner.FramebufferSize(&sceneDesc.Width, &sceneDesc.Height);
+        if (sceneDesc.Width == 0 || sceneDesc.Height == 0)
+        {
+            runner.EndFrame();
+            continue;
+        }
+        // follows the framebuffer size, the pool reallocates on the first frame after a resize
+        RenderTarget& sceneTarget = runner.Targets().Acquire(sceneDesc);
+        int sceneWidth = sceneDesc.Width, sceneHeight = sceneDesc.Height;
+        sceneTarget.Bind();
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         glEnable(GL_DEPTH_TEST);
 
         // configure transformation matrices
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
-        glm::mat4 view = camera.GetViewMatirx();;
+        glm::mat4 projection = ReverseZ::Perspective(glm::radians(45.0f), (float)sceneWidth / (float)sceneHeight, 0.1f, 1000.0f);
+        glm::mat4 view = camera.GetViewMatirx();
         shader.use();
         shader.setMat4("projection", projection);
         shader.setMat4("view", view);
 
-        // draw planet
-   /*     glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, -3.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(4.0f, 4.0f, 4.0f));
-        shader.setMat4("model", model);
-        planet.Draw(shader);*/
-
-        // draw meteorites
+        // draw planet: with the per-instance arrays switched off the instancing shader reads the
+        // constant attribute values, so one draw with its own matrices needs no buffer of its own
         shader.setInt("texture_diffuse1", 0);
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, planet.loadedTexture[0].id);
         for (unsigned int i = 0; i < planet.meshes.size(); i++)
         {
             glBindVertexArray(planet.meshes[i].VAO);
-            glDrawElementsInstanced(GL_TRIANGLES, planet.meshes[i].indices.size(), GL_UNSIGNED_INT, 0, amount);
+            for (unsigned int column = 0; column < 4; column++)
+            {
+                glDisableVertexAttribArray(3 + column);
+                glVertexAttrib4fv(3 + column, &planetModel[column][0]);
+            }
+            for (unsigned int column = 0; normalVBO != 0 && column < 3; column++)
+            {
+                glDisableVertexAttribArray(8 + column);
+                glVertexAttrib3fv(8 + column, &planetNormalMatrix[column][0]);
+            }
+            glDrawElements(GL_TRIANGLES, planet.meshes[i].indices.size(), GL_UNSIGNED_INT, 0);
+            for (unsigned int column = 0; column < 4; column++)
+                glEnableVertexAttribArray(3 + column);
+            for (unsigned int column = 0; normalVBO != 0 && column < 3; column++)
+                glEnableVertexAttribArray(8 + column);
+        }
+        glBindVertexArray(0);
+
+        // keep the instances that were not hidden last frame
+        unsigned int instanceCount = amount;
+        if (occlusionCulling)
+        {
+            hiZ.Cull(modelMatrices, amount, localMin, localMax, visible);
+            instanceCount = (unsigned int)visible.size();
+            visibleMatrices.resize(instanceCount);
+            for (unsigned int i = 0; i < instanceCount; i++)
+                visibleMatrices[i] = modelMatrices[visible[i]];
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, instanceCount * sizeof(glm::mat4), visibleMatrices.data());
+            if (normalVBO != 0)
+            {
+                visibleNormalMatrices.resize(instanceCount);
+                for (unsigned int i = 0; i < instanceCount; i++)
+                    visibleNormalMatrices[i] = normalMatrices[visible[i]];
+                glBindBuffer(GL_ARRAY_BUFFER, normalVBO);
+                glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat3), NULL, GL_STREAM_DRAW);
+                glBufferSubData(GL_ARRAY_BUFFER, 0, instanceCount * sizeof(glm::mat3), visibleNormalMatrices.data());
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+            string title = "LearnOpenGL - occlusion culled " + to_string(hiZ.LastCulled()) + " / " + to_string(hiZ.LastTested());
+            runner.SetTitle(title);
+        }
+
+        // draw meteorites
+        for (unsigned int i = 0; i < planet.meshes.size(); i++)
+        {
+            glBindVertexArray(planet.meshes[i].VAO);
+            glDrawElementsInstanced(GL_TRIANGLES, planet.meshes[i].indices.size(), GL_UNSIGNED_INT, 0, instanceCount);
             glBindVertexArray(0);
         }
 
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        // this frame's depth becomes the next frames' occluders
+        if (occlusionCulling)
+            hiZ.Build(sceneTarget.DepthTexture, sceneWidth, sceneHeight, projection * view);
+
+        // present
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneTarget.FBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, sceneWidth, sceneHeight, 0, 0, sceneWidth, sceneHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        // swap buffers and poll IO events, or record the frame when headless
+        // -------------------------------------------------------------------
+        runner.EndFrame();
     }
 
-    glfwTerminate();
-    return 0;
+    delete[] normalMatrices;
+    delete[] modelMatrices;
+    return runner.ExitCode();
 }
 
 void processInput(GLFWwindow* window)
@@ -224,6 +342,7 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 
 unsigned int loadTexture(char const* path)
 {
+    GPU_MEMORY_OWNER("texture");
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
@@ -19,6 +19,15 @@ const float SPEED = 5.0f;
 const float SENSITIVITY = 0.1f;
 const float FOV = 45.0f;
 
+// sees every input callback the camera handles, e.g. CameraInputLog (camerapath.h)
+class CameraInputListener {
+public:
+    virtual ~CameraInputListener() {}
+    virtual void OnKeyboard(Camera_Movement direction, float deltaTime) = 0;
+    virtual void OnMouseMove(float xoffset, float yoffset, bool bForceStop) = 0;
+    virtual void OnMouseScroll(float yoffset) = 0;
+};
+
 class Camera {
 public:
 	glm::vec3 Position;
@@ -34,7 +43,9 @@ public:
     float MouseSensitivity;
     float Fov;
 
-    Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Fov(FOV)
+    CameraInputListener* InputListener;
+
+    Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Fov(FOV), InputListener(nullptr)
     {
         Position = position;
         WorldUp = up;
@@ -49,6 +60,8 @@ public:
 
     void KeyBoradCallBack(Camera_Movement direction, float deltaTime)
     {
+        if (InputListener)
+            InputListener->OnKeyboard(direction, deltaTime);
         float velocity = MovementSpeed * deltaTime;
         if (direction == FORWARD)
             Position += Front * velocity;
@@ -65,6 +78,8 @@ public:
 
     void MouseMoveCallBack(float xoffset, float yoffset, bool bForceStop = true)
     {
+        if (InputListener)
+            InputListener->OnMouseMove(xoffset, yoffset, bForceStop);
         xoffset *= MouseSensitivity;
         yoffset *= MouseSensitivity;
 
@@ -85,6 +100,8 @@ public:
 
     void MouseSrollCallBack(float yoffset)
     {
+        if (InputListener)
+            InputListener->OnMouseScroll(yoffset);
         Fov -= (float)yoffset;
 
         if (Fov <= 1.0f)
@@ -94,6 +111,16 @@ public:
             Fov = 45.0f;
     }
 
+    // places the camera directly, for scripted and replayed views
+    void SetView(glm::vec3 position, float yaw, float pitch, float fov = FOV)
+    {
+        Position = position;
+        Yaw = yaw;
+        Pitch = pitch;
+        Fov = fov;
+        updateCameraVectors();
+    }
+
 private:
     void updateCameraVectors()
     {
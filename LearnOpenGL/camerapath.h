@@ -0,0 +1,283 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "camera.h"
+
+// Keyframed camera flythrough. A path file has one keyframe per line,
+//   time  x y z  yaw pitch  [fov]
+// with time in seconds, increasing, and '#' starting a comment. Position and
+// angles follow a Catmull-Rom spline through the keyframes, with tangents
+// weighted by the keyframe spacing so unevenly timed keys move smoothly.
+class CameraPath
+{
+public:
+    bool Load(const std::string& path)
+    {
+        keys.clear();
+        std::ifstream file(path.c_str());
+        if (!file)
+        {
+            std::cout << "ERROR::CAMERA_PATH:: could not open " << path << std::endl;
+            return false;
+        }
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(file, line))
+        {
+            lineNumber++;
+            line = line.substr(0, line.find('#'));
+            std::istringstream stream(line);
+            Key key;
+            if (!(stream >> key.Time))
+                continue;
+            if (!(stream >> key.Position.x >> key.Position.y >> key.Position.z >> key.Yaw >> key.Pitch))
+            {
+                std::cout << "ERROR::CAMERA_PATH:: " << path << ":" << lineNumber << " expects time x y z yaw pitch [fov]" << std::endl;
+                keys.clear();
+                return false;
+            }
+            if (!(stream >> key.Fov))
+                key.Fov = FOV;
+            if (!keys.empty() && key.Time <= keys.back().Time)
+            {
+                std::cout << "ERROR::CAMERA_PATH:: " << path << ":" << lineNumber << " keyframe times must increase" << std::endl;
+                keys.clear();
+                return false;
+            }
+            keys.push_back(key);
+        }
+        if (keys.empty())
+            std::cout << "ERROR::CAMERA_PATH:: " << path << " has no keyframes" << std::endl;
+        return !keys.empty();
+    }
+
+    bool Empty() const
+    {
+        return keys.empty();
+    }
+
+    size_t KeyCount() const
+    {
+        return keys.size();
+    }
+
+    float KeyTime(size_t i) const
+    {
+        return keys[i].Time;
+    }
+
+    // time of the last keyframe, the view holds still after it
+    float Duration() const
+    {
+        return keys.empty() ? 0.0f : keys.back().Time;
+    }
+
+    // places the camera at time seconds along the path
+    void Apply(float time, Camera& camera) const
+    {
+        if (keys.empty())
+            return;
+        if (time <= keys.front().Time || keys.size() == 1)
+        {
+            set(keys.front(), camera);
+            return;
+        }
+        if (time >= keys.back().Time)
+        {
+            set(keys.back(), camera);
+            return;
+        }
+
+        size_t i = 0;
+        while (keys[i + 1].Time < time)
+            i++;
+        const Key& k0 = keys[i];
+        const Key& k1 = keys[i + 1];
+        float h = k1.Time - k0.Time;
+        float s = (time - k0.Time) / h;
+
+        // cubic Hermite basis
+        float s2 = s * s, s3 = s2 * s;
+        float h00 = 2.0f * s3 - 3.0f * s2 + 1.0f;
+        float h10 = s3 - 2.0f * s2 + s;
+        float h01 = -2.0f * s3 + 3.0f * s2;
+        float h11 = s3 - s2;
+
+        Key m0 = tangent(i), m1 = tangent(i + 1);
+        Key key;
+        key.Position = h00 * k0.Position + h10 * h * m0.Position + h01 * k1.Position + h11 * h * m1.Position;
+        key.Yaw = h00 * k0.Yaw + h10 * h * m0.Yaw + h01 * k1.Yaw + h11 * h * m1.Yaw;
+        key.Pitch = h00 * k0.Pitch + h10 * h * m0.Pitch + h01 * k1.Pitch + h11 * h * m1.Pitch;
+        key.Fov = h00 * k0.Fov + h10 * h * m0.Fov + h01 * k1.Fov + h11 * h * m1.Fov;
+        set(key, camera);
+    }
+
+private:
+    struct Key {
+        float Time = 0.0f;
+        glm::vec3 Position = glm::vec3(0.0f);
+        float Yaw = 0.0f;
+        float Pitch = 0.0f;
+        float Fov = FOV;
+    };
+
+    std::vector<Key> keys;
+
+    // derivative per second at key i, central difference, one sided at the ends
+    Key tangent(size_t i) const
+    {
+        const Key& a = keys[i > 0 ? i - 1 : i];
+        const Key& b = keys[i + 1 < keys.size() ? i + 1 : i];
+        float dt = b.Time - a.Time;
+        Key m;
+        m.Position = (b.Position - a.Position) / dt;
+        m.Yaw = (b.Yaw - a.Yaw) / dt;
+        m.Pitch = (b.Pitch - a.Pitch) / dt;
+        m.Fov = (b.Fov - a.Fov) / dt;
+        return m;
+    }
+
+    static void set(const Key& key, Camera& camera)
+    {
+        camera.SetView(key.Position, key.Yaw, key.Pitch, key.Fov);
+    }
+};
+
+// Records the input callbacks a Camera receives, tagged with the frame they
+// arrived in, and replays them on the same frames. The callbacks carry their
+// own deltaTime, so a replay reproduces every view exactly whatever the frame
+// rate. Only camera input is captured, not the demos' own key toggles.
+// Values are written with full float precision, one event per line:
+//   frame K direction deltaTime | frame M xoffset yoffset forceStop | frame S yoffset
+class CameraInputLog : public CameraInputListener
+{
+public:
+    // frame the following events belong to while recording
+    void SetFrame(unsigned int frame)
+    {
+        currentFrame = frame;
+    }
+
+    void OnKeyboard(Camera_Movement direction, float deltaTime) override
+    {
+        events.push_back({ currentFrame, 'K', (float)direction, deltaTime, 0 });
+    }
+
+    void OnMouseMove(float xoffset, float yoffset, bool bForceStop) override
+    {
+        events.push_back({ currentFrame, 'M', xoffset, yoffset, bForceStop ? 1 : 0 });
+    }
+
+    void OnMouseScroll(float yoffset) override
+    {
+        events.push_back({ currentFrame, 'S', yoffset, 0.0f, 0 });
+    }
+
+    size_t EventCount() const
+    {
+        return events.size();
+    }
+
+    bool Save(const std::string& path) const
+    {
+        std::ofstream file(path.c_str());
+        if (!file)
+        {
+            std::cout << "ERROR::CAMERA_INPUT:: could not write " << path << std::endl;
+            return false;
+        }
+        file << std::setprecision(9);
+        for (const Event& e : events)
+        {
+            file << e.Frame << " " << e.Type << " ";
+            if (e.Type == 'K')
+                file << (int)e.A << " " << e.B;
+            else if (e.Type == 'M')
+                file << e.A << " " << e.B << " " << e.Flag;
+            else
+                file << e.A;
+            file << "\n";
+        }
+        return file.good();
+    }
+
+    bool Load(const std::string& path)
+    {
+        events.clear();
+        next = 0;
+        std::ifstream file(path.c_str());
+        if (!file)
+        {
+            std::cout << "ERROR::CAMERA_INPUT:: could not open " << path << std::endl;
+            return false;
+        }
+        Event e;
+        while (file >> e.Frame >> e.Type)
+        {
+            bool ok = true;
+            if (e.Type == 'K')
+            {
+                int direction;
+                ok = (bool)(file >> direction >> e.B);
+                e.A = (float)direction;
+            }
+            else if (e.Type == 'M')
+                ok = (bool)(file >> e.A >> e.B >> e.Flag);
+            else if (e.Type == 'S')
+                ok = (bool)(file >> e.A);
+            else
+                ok = false;
+            if (!ok)
+            {
+                std::cout << "ERROR::CAMERA_INPUT:: " << path << " is malformed after " << events.size() << " events" << std::endl;
+                events.clear();
+                return false;
+            }
+            events.push_back(e);
+        }
+        return true;
+    }
+
+    // re-issues the events recorded for frame, in their original order
+    void Replay(unsigned int frame, Camera& camera)
+    {
+        CameraInputListener* listener = camera.InputListener;
+        camera.InputListener = nullptr;
+        for (; next < events.size() && events[next].Frame <= frame; next++)
+        {
+            const Event& e = events[next];
+            if (e.Type == 'K')
+                camera.KeyBoradCallBack((Camera_Movement)(int)e.A, e.B);
+            else if (e.Type == 'M')
+                camera.MouseMoveCallBack(e.A, e.B, e.Flag != 0);
+            else
+                camera.MouseSrollCallBack(e.A);
+        }
+        camera.InputListener = listener;
+    }
+
+    // every recorded event has been replayed
+    bool Finished() const
+    {
+        return next >= events.size();
+    }
+
+private:
+    struct Event {
+        unsigned int Frame;
+        char Type;
+        float A, B;
+        int Flag;
+    };
+
+    std::vector<Event> events;
+    unsigned int currentFrame = 0;
+    size_t next = 0;
+};
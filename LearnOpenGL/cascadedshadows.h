@@ -0,0 +1,246 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <string>
+#include <iostream>
+
+#include "shader.h"
+#include "reversez.h"
+#include "gpumemory.h"
+#include "workerpool.h"
+
+// world space bounding box of something that casts a shadow
+struct ShadowCaster {
+    glm::vec3 BoundsMin;
+    glm::vec3 BoundsMax;
+    bool Dynamic;       // moves every frame, left out of the depth fit under quantized placement
+};
+
+// Cascaded shadow maps for a directional light. The camera frustum is cut
+// into 2-4 depth ranges (practical split scheme), each range gets its own
+// orthographic light projection rendered into one layer of a depth texture
+// array. Projections are fitted to a bounding sphere of the range and snapped
+// to whole shadow texels, so they only move in texel steps and edges do not
+// shimmer as the camera moves or turns. Update() fits every cascade and culls
+// the casters against it on the threads of a WorkerPool created with the map.
+// Depth follows ReverseZ, create the map after ReverseZ::Enable() when the
+// application uses it.
+class CascadedShadowMap
+{
+public:
+    static const int MAX_CASCADES = 4;
+
+    struct Cascade {
+        glm::mat4 LightSpaceMatrix;
+        float SplitFar;                     // view space distance where the next cascade takes over
+        std::vector<unsigned int> Casters;  // indices of the casters overlapping this cascade
+    };
+
+    unsigned int FBO;
+    unsigned int DepthArray;
+
+    CascadedShadowMap(int cascadeCount = 3, int resolution = 2048, float splitLambda = 0.75f)
+        : FBO(0), DepthArray(0), cascadeCount(std::min(std::max(cascadeCount, 2), (int)MAX_CASCADES)), resolution(resolution), splitLambda(splitLambda), quantizedPlacement(false), updateMs(0.0)
+    {
+        GPU_MEMORY_OWNER("shadow cascades");
+        glGenTextures(1, &DepthArray);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, DepthArray);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, resolution, resolution, this->cascadeCount, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        // sampled through sampler2DArrayShadow: the hardware compares and filters the 2x2 results
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, ReverseZ::DepthFuncOrEqual());
+        // outside the cascade is lit
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        float farDepth = ReverseZ::FarDepth();
+        float borderColor[] = { farDepth, farDepth, farDepth, farDepth };
+        glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, DepthArray, 0, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: Cascaded shadow map is not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    ~CascadedShadowMap()
+    {
+        glDeleteFramebuffers(1, &FBO);
+        glDeleteTextures(1, &DepthArray);
+    }
+
+    // fits all cascades to the camera frustum and culls casters, lightDirection points from the light into the scene
+    void Update(const glm::mat4& view, float fovY, float aspect, float zNear, float zFar, const glm::vec3& lightDirection, const std::vector<ShadowCaster>& casters)
+    {
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+        // practical split scheme: blend of logarithmic and uniform splits
+        for (int i = 0; i < cascadeCount; i++)
+        {
+            float p = (float)(i + 1) / cascadeCount;
+            float logSplit = zNear * std::pow(zFar / zNear, p);
+            float uniformSplit = zNear + (zFar - zNear) * p;
+            cascades[i].SplitFar = splitLambda * logSplit + (1.0f - splitLambda) * uniformSplit;
+        }
+
+        glm::mat4 inverseView = glm::inverse(view);
+        glm::vec3 direction = glm::normalize(lightDirection);
+        workers.ParallelFor((unsigned int)cascadeCount, [&](unsigned int i) { fitCascade((int)i, inverseView, fovY, aspect, zNear, direction, casters); });
+
+        updateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // binds the FBO to the cascade's layer and clears it, the caller draws the cascade's casters next
+    void BeginCascade(int cascade, bool clear = true)
+    {
+        glViewport(0, 0, resolution, resolution);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, DepthArray, 0, cascade);
+        if (clear)
+            glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    // moves each cascade in steps of a tenth of its radius (padding it to match)
+    // instead of every texel, so its matrix stays bit-identical for many frames
+    // and a StaticShadowCache layer stays valid while the camera moves a little.
+    // The depth range then only covers the static casters, dynamic ones between
+    // it and the light must be drawn with GL_DEPTH_CLAMP.
+    void SetQuantizedPlacement(bool enabled)
+    {
+        quantizedPlacement = enabled;
+    }
+
+    // sets the sampler and cascade uniforms read by fs_depth.frag
+    void Bind(Shader& shader, int unit)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, DepthArray);
+        glActiveTexture(GL_TEXTURE0);
+        shader.setInt("shadowMap", unit);
+        shader.setInt("cascadeCount", cascadeCount);
+        for (int i = 0; i < cascadeCount; i++)
+        {
+            std::string index = "[" + std::to_string(i) + "]";
+            shader.setMat4("lightSpaceMatrices" + index, cascades[i].LightSpaceMatrix);
+            shader.setFloat("cascadeSplits" + index, cascades[i].SplitFar);
+        }
+    }
+
+    const Cascade& GetCascade(int cascade) const
+    {
+        return cascades[cascade];
+    }
+
+    int CascadeCount() const
+    {
+        return cascadeCount;
+    }
+
+    int Resolution() const
+    {
+        return resolution;
+    }
+
+    // CPU time of the last Update
+    double UpdateMs() const
+    {
+        return updateMs;
+    }
+
+private:
+    int cascadeCount;
+    int resolution;
+    float splitLambda;
+    bool quantizedPlacement;
+    double updateMs;
+    Cascade cascades[MAX_CASCADES];
+    WorkerPool workers;
+
+    void fitCascade(int cascade, const glm::mat4& inverseView, float fovY, float aspect, float zNear, glm::vec3 direction, const std::vector<ShadowCaster>& casters)
+    {
+        float splitNear = cascade == 0 ? zNear : cascades[cascade - 1].SplitFar;
+        float splitFar = cascades[cascade].SplitFar;
+
+        // world space corners of this slice of the camera frustum
+        float tanY = std::tan(fovY * 0.5f);
+        float tanX = tanY * aspect;
+        glm::vec3 corners[8];
+        glm::vec3 center(0.0f);
+        for (int i = 0; i < 8; i++)
+        {
+            float d = (i & 1) ? splitFar : splitNear;
+            glm::vec4 corner = inverseView * glm::vec4(((i & 2) ? 1.0f : -1.0f) * tanX * d, ((i & 4) ? 1.0f : -1.0f) * tanY * d, -d, 1.0f);
+            corners[i] = glm::vec3(corner);
+            center += corners[i] / 8.0f;
+        }
+
+        // a sphere does not change size when the camera turns, round it so float noise does not either
+        float radius = 0.0f;
+        for (int i = 0; i < 8; i++)
+            radius = std::max(radius, glm::length(corners[i] - center));
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        // constant orientation, only the position follows the camera
+        glm::vec3 up = std::fabs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        float step = radius * 0.1f;
+        if (quantizedPlacement)
+        {
+            // a snap moves the center by at most step * sqrt(3) / 2 < step
+            glm::mat4 lightRotation = glm::lookAt(glm::vec3(0.0f), direction, up);
+            glm::vec3 lightCenter = glm::vec3(lightRotation * glm::vec4(center, 1.0f));
+            lightCenter = glm::floor(lightCenter / step + 0.5f) * step;
+            center = glm::vec3(glm::inverse(lightRotation) * glm::vec4(lightCenter, 1.0f));
+            radius += step;
+        }
+        glm::mat4 lightView = glm::lookAt(center - direction * radius, center, up);
+
+        // cull casters in light space: they must overlap the cascade sideways, but may lie anywhere towards the light
+        Cascade& result = cascades[cascade];
+        result.Casters.clear();
+        float nearest = 0.0f;
+        for (unsigned int c = 0; c < casters.size(); c++)
+        {
+            glm::vec3 lightMin(1e30f), lightMax(-1e30f);
+            for (int i = 0; i < 8; i++)
+            {
+                glm::vec3 corner((i & 1) ? casters[c].BoundsMax.x : casters[c].BoundsMin.x, (i & 2) ? casters[c].BoundsMax.y : casters[c].BoundsMin.y, (i & 4) ? casters[c].BoundsMax.z : casters[c].BoundsMin.z);
+                glm::vec3 p = glm::vec3(lightView * glm::vec4(corner, 1.0f));
+                lightMin = glm::min(lightMin, p);
+                lightMax = glm::max(lightMax, p);
+            }
+            if (lightMax.x < -radius || lightMin.x > radius || lightMax.y < -radius || lightMin.y > radius || -lightMax.z > 2.0f * radius)
+                continue;
+            result.Casters.push_back(c);
+            // a moving caster would pull the near plane along and change the matrix every frame,
+            // it is drawn with depth clamp instead, flattened onto the near plane
+            if (!quantizedPlacement || !casters[c].Dynamic)
+                nearest = std::min(nearest, -lightMax.z);
+        }
+
+        if (quantizedPlacement)
+            nearest = std::floor(nearest / (10.0f * step)) * (10.0f * step);
+        glm::mat4 lightProjection = ReverseZ::Ortho(-radius, radius, -radius, radius, nearest, 2.0f * radius);
+
+        // snap the projected world origin to a whole texel
+        glm::mat4 shadowMatrix = lightProjection * lightView;
+        glm::vec4 origin = shadowMatrix * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f) * (resolution * 0.5f);
+        glm::vec2 offset = (glm::round(glm::vec2(origin)) - glm::vec2(origin)) * (2.0f / resolution);
+        lightProjection[3][0] += offset.x;
+        lightProjection[3][1] += offset.y;
+
+        result.LightSpaceMatrix = lightProjection * lightView;
+    }
+};
@@ -0,0 +1,59 @@
+// clustered point lights, filled every frame by ClusteredLights (clusteredlights.h)
+// the includer provides the material colors, so these functions sample no material
+
+uniform samplerBuffer clusterLights;    // two texels per light: position, radius / color, intensity
+uniform usamplerBuffer clusterGrid;     // per cluster: first entry in clusterIndices, light count
+uniform usamplerBuffer clusterIndices;
+
+uniform int clusterDimX;
+uniform int clusterDimY;
+uniform int clusterDimZ;
+uniform float clusterTileWidth;
+uniform float clusterTileHeight;
+uniform float clusterZScale;
+uniform float clusterZBias;
+
+int GetClusterIndex(vec2 fragCoord, float viewDepth)
+{
+	int x = min(int(fragCoord.x / clusterTileWidth), clusterDimX - 1);
+	int y = min(int(fragCoord.y / clusterTileHeight), clusterDimY - 1);
+	// exponential depth slices: slice = log(depth) * scale + bias
+	int z = clamp(int(floor(log(viewDepth) * clusterZScale + clusterZBias)), 0, clusterDimZ - 1);
+	return x + clusterDimX * (y + clusterDimY * z);
+}
+
+// inverse square falloff windowed to reach exactly zero at the light radius,
+// so no light is missing from a cluster it still affects
+float CalcClusteredAttenuation(float distance, float radius)
+{
+	float ratio = distance / radius;
+	float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+	return window * window / (distance * distance + 1.0);
+}
+
+vec3 CalcClusteredLights(vec2 fragCoord, float viewDepth, vec3 vertPos, vec3 normal, vec3 viewDir, vec3 diffuseColor, vec3 specularColor, float shininess)
+{
+	uvec2 cluster = texelFetch(clusterGrid, GetClusterIndex(fragCoord, viewDepth)).rg;
+
+	vec3 result = vec3(0.0);
+	for (uint i = 0u; i < cluster.y; i++)
+	{
+		int lightIndex = int(texelFetch(clusterIndices, int(cluster.x + i)).r);
+		vec4 positionRadius = texelFetch(clusterLights, lightIndex * 2);
+		vec4 colorIntensity = texelFetch(clusterLights, lightIndex * 2 + 1);
+
+		vec3 toLight = positionRadius.xyz - vertPos;
+		float distance = length(toLight);
+		if (distance >= positionRadius.w)
+			continue;
+
+		vec3 lightDir = toLight / distance;
+		float diff = max(dot(normal, lightDir), 0.0);
+		vec3 reflectDir = reflect(-lightDir, normal);
+		float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+
+		vec3 radiance = colorIntensity.rgb * colorIntensity.a * CalcClusteredAttenuation(distance, positionRadius.w);
+		result += (diff * diffuseColor + spec * specularColor) * radiance;
+	}
+	return result;
+}
@@ -0,0 +1,346 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+#include "shader.h"
+#include "gpumemory.h"
+#include "workerpool.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define LOGL_CLUSTER_SSE 1
+#include <xmmintrin.h>
+#endif
+
+struct ClusteredLight {
+    glm::vec3 Position;     // world space
+    float Radius;           // the light contributes nothing past this distance
+    glm::vec3 Color;
+    float Intensity;
+};
+
+// Clustered forward shading. The view frustum is split into a GRID_X x GRID_Y
+// screen tile grid with GRID_Z exponential depth slices ("froxels"). Every
+// frame Update() tests each light's bounding sphere against the clusters its
+// depth range touches (four clusters per SSE test, slices spread across the
+// worker threads of a WorkerPool created with it) and uploads three texture buffers that clustered.glsl reads:
+// the light data, an (offset, count) pair per cluster and the light index list.
+class ClusteredLights
+{
+public:
+    static const int GRID_X = 16;
+    static const int GRID_Y = 9;
+    static const int GRID_Z = 24;
+    static const int MAX_LIGHTS_PER_CLUSTER = 512;
+
+    std::vector<ClusteredLight> Lights;
+
+    ClusteredLights() : fovY(0.0f), aspect(0.0f), nearPlane(0.0f), farPlane(0.0f), screenWidth(0), screenHeight(0), assignMs(0.0), indexCount(0), overflowReported(false)
+    {
+        clusterCounts.resize(clusterCount());
+        clusterLights.resize(clusterCount() * MAX_LIGHTS_PER_CLUSTER);
+        grid.resize(clusterCount() * 2);
+        sliceLights.resize(GRID_Z);
+
+        GPU_MEMORY_OWNER("light clusters");
+        glGenBuffers(3, buffers);
+        glGenTextures(3, textures);
+        const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+        for (int i = 0; i < 3; i++)
+        {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    }
+
+    ~ClusteredLights()
+    {
+        glDeleteTextures(3, textures);
+        glDeleteBuffers(3, buffers);
+    }
+
+    // the cluster bounds depend only on the projection, they are rebuilt when it changes
+    void Configure(float fovYRadians, float aspectRatio, float zNear, float zFar, int width, int height)
+    {
+        if (fovYRadians == fovY && aspectRatio == aspect && zNear == nearPlane && zFar == farPlane && width == screenWidth && height == screenHeight)
+            return;
+        fovY = fovYRadians;
+        aspect = aspectRatio;
+        nearPlane = zNear;
+        farPlane = zFar;
+        screenWidth = width;
+        screenHeight = height;
+        buildClusterBounds();
+    }
+
+    // assigns lights to clusters and uploads the result, call once per frame after Configure
+    void Update(const glm::mat4& view)
+    {
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        assign(view);
+        assignMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        upload();
+    }
+
+    // binds the three buffers to texture units firstUnit..firstUnit+2, keep them above the material textures
+    void Bind(Shader& shader, int firstUnit)
+    {
+        const char* samplers[3] = { "clusterLights", "clusterGrid", "clusterIndices" };
+        for (int i = 0; i < 3; i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+            shader.setInt(samplers[i], firstUnit + i);
+        }
+        glActiveTexture(GL_TEXTURE0);
+
+        float logRatio = std::log(farPlane / nearPlane);
+        shader.setInt("clusterDimX", GRID_X);
+        shader.setInt("clusterDimY", GRID_Y);
+        shader.setInt("clusterDimZ", GRID_Z);
+        shader.setFloat("clusterTileWidth", (float)screenWidth / GRID_X);
+        shader.setFloat("clusterTileHeight", (float)screenHeight / GRID_Y);
+        shader.setFloat("clusterZScale", GRID_Z / logRatio);
+        shader.setFloat("clusterZBias", -GRID_Z * std::log(nearPlane) / logRatio);
+    }
+
+    // CPU time of the last light assignment
+    double AssignMs() const
+    {
+        return assignMs;
+    }
+
+    // total light references over all clusters after the last Update
+    unsigned int IndexCount() const
+    {
+        return indexCount;
+    }
+
+private:
+    float fovY, aspect, nearPlane, farPlane;
+    int screenWidth, screenHeight;
+    double assignMs;
+    unsigned int indexCount;
+    bool overflowReported;
+    int maxTexels;
+
+    unsigned int buffers[3];    // lights, grid, indices
+    unsigned int textures[3];
+
+    // view space cluster AABBs, structure of arrays so four clusters of a slice load at once
+    std::vector<float> boundsMinX, boundsMinY, boundsMinZ, boundsMaxX, boundsMaxY, boundsMaxZ;
+    std::vector<glm::vec4> viewSpheres;                 // view space center, radius
+    std::vector<std::vector<unsigned int> > sliceLights; // lights whose depth range touches each slice
+    std::vector<unsigned int> clusterCounts;
+    std::vector<unsigned int> clusterLights;            // MAX_LIGHTS_PER_CLUSTER slots per cluster
+    std::vector<unsigned int> grid;                     // offset, count per cluster
+    std::vector<unsigned int> indices;
+    WorkerPool workers;
+
+    static int clusterCount()
+    {
+        return GRID_X * GRID_Y * GRID_Z;
+    }
+
+    static int tilesPerSlice()
+    {
+        return GRID_X * GRID_Y;
+    }
+
+    float sliceDepth(int slice) const
+    {
+        return nearPlane * std::pow(farPlane / nearPlane, (float)slice / GRID_Z);
+    }
+
+    int sliceOf(float depth) const
+    {
+        int slice = (int)std::floor(std::log(depth / nearPlane) / std::log(farPlane / nearPlane) * GRID_Z);
+        return std::min(std::max(slice, 0), GRID_Z - 1);
+    }
+
+    void buildClusterBounds()
+    {
+        boundsMinX.resize(clusterCount());
+        boundsMinY.resize(clusterCount());
+        boundsMinZ.resize(clusterCount());
+        boundsMaxX.resize(clusterCount());
+        boundsMaxY.resize(clusterCount());
+        boundsMaxZ.resize(clusterCount());
+
+        float tanY = std::tan(fovY * 0.5f);
+        float tanX = tanY * aspect;
+        for (int z = 0; z < GRID_Z; z++)
+        {
+            float depths[2] = { sliceDepth(z), sliceDepth(z + 1) };
+            for (int y = 0; y < GRID_Y; y++)
+            {
+                // tile row 0 is the bottom of the screen, like gl_FragCoord
+                float ndcY[2] = { -1.0f + 2.0f * y / GRID_Y, -1.0f + 2.0f * (y + 1) / GRID_Y };
+                for (int x = 0; x < GRID_X; x++)
+                {
+                    float ndcX[2] = { -1.0f + 2.0f * x / GRID_X, -1.0f + 2.0f * (x + 1) / GRID_X };
+                    glm::vec3 minCorner(1e30f), maxCorner(-1e30f);
+                    for (int corner = 0; corner < 8; corner++)
+                    {
+                        float d = depths[corner & 1];
+                        glm::vec3 p(ndcX[(corner >> 1) & 1] * tanX * d, ndcY[(corner >> 2) & 1] * tanY * d, -d);
+                        minCorner = glm::min(minCorner, p);
+                        maxCorner = glm::max(maxCorner, p);
+                    }
+
+                    int cluster = x + GRID_X * (y + GRID_Y * z);
+                    boundsMinX[cluster] = minCorner.x;
+                    boundsMinY[cluster] = minCorner.y;
+                    boundsMinZ[cluster] = minCorner.z;
+                    boundsMaxX[cluster] = maxCorner.x;
+                    boundsMaxY[cluster] = maxCorner.y;
+                    boundsMaxZ[cluster] = maxCorner.z;
+                }
+            }
+        }
+    }
+
+    void assign(const glm::mat4& view)
+    {
+        std::fill(clusterCounts.begin(), clusterCounts.end(), 0u);
+        for (int z = 0; z < GRID_Z; z++)
+            sliceLights[z].clear();
+
+        // bucket the lights by the depth slices their sphere overlaps
+        viewSpheres.resize(Lights.size());
+        for (unsigned int i = 0; i < Lights.size(); i++)
+        {
+            glm::vec3 center = glm::vec3(view * glm::vec4(Lights[i].Position, 1.0f));
+            float radius = Lights[i].Radius;
+            viewSpheres[i] = glm::vec4(center, radius);
+
+            float depth = -center.z;
+            if (radius <= 0.0f || depth + radius < nearPlane || depth - radius > farPlane)
+                continue;
+            int firstSlice = sliceOf(std::max(depth - radius, nearPlane));
+            int lastSlice = sliceOf(std::min(depth + radius, farPlane));
+            for (int z = firstSlice; z <= lastSlice; z++)
+                sliceLights[z].push_back(i);
+        }
+
+        // slices write disjoint clusters, so workers share nothing
+        std::function<void(unsigned int)> assignSlice = [this](unsigned int z) {
+            for (unsigned int i = 0; i < sliceLights[z].size(); i++)
+                testSlice(z, sliceLights[z][i]);
+        };
+        if (Lights.size() < 256)
+        {
+            for (int z = 0; z < GRID_Z; z++)
+                assignSlice(z);
+        }
+        else
+        {
+            workers.ParallelFor(GRID_Z, assignSlice);
+        }
+
+        compact();
+    }
+
+    void testSlice(int z, unsigned int lightIndex)
+    {
+        const glm::vec4& sphere = viewSpheres[lightIndex];
+        int base = z * tilesPerSlice();
+#ifdef LOGL_CLUSTER_SSE
+        const __m128 cx = _mm_set1_ps(sphere.x);
+        const __m128 cy = _mm_set1_ps(sphere.y);
+        const __m128 cz = _mm_set1_ps(sphere.z);
+        const __m128 r2 = _mm_set1_ps(sphere.w * sphere.w);
+        const __m128 zero = _mm_setzero_ps();
+        for (int t = 0; t < tilesPerSlice(); t += 4)
+        {
+            int c = base + t;
+            // squared distance from the sphere center to the box, per axis max(min - c, c - max, 0)
+            __m128 dx = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&boundsMinX[c]), cx), _mm_sub_ps(cx, _mm_loadu_ps(&boundsMaxX[c]))));
+            __m128 dy = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&boundsMinY[c]), cy), _mm_sub_ps(cy, _mm_loadu_ps(&boundsMaxY[c]))));
+            __m128 dz = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&boundsMinZ[c]), cz), _mm_sub_ps(cz, _mm_loadu_ps(&boundsMaxZ[c]))));
+            __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            int mask = _mm_movemask_ps(_mm_cmple_ps(distance2, r2));
+            for (int lane = 0; mask != 0; lane++, mask >>= 1)
+            {
+                if (mask & 1)
+                    addToCluster(c + lane, lightIndex);
+            }
+        }
+#else
+        float r2 = sphere.w * sphere.w;
+        for (int t = 0; t < tilesPerSlice(); t++)
+        {
+            int c = base + t;
+            float dx = std::max(0.0f, std::max(boundsMinX[c] - sphere.x, sphere.x - boundsMaxX[c]));
+            float dy = std::max(0.0f, std::max(boundsMinY[c] - sphere.y, sphere.y - boundsMaxY[c]));
+            float dz = std::max(0.0f, std::max(boundsMinZ[c] - sphere.z, sphere.z - boundsMaxZ[c]));
+            if (dx * dx + dy * dy + dz * dz <= r2)
+                addToCluster(c, lightIndex);
+        }
+#endif
+    }
+
+    void addToCluster(int cluster, unsigned int lightIndex)
+    {
+        // keeps counting past the capacity so compact() can tell that lights were dropped
+        unsigned int count = clusterCounts[cluster]++;
+        if (count < (unsigned int)MAX_LIGHTS_PER_CLUSTER)
+            clusterLights[cluster * MAX_LIGHTS_PER_CLUSTER + count] = lightIndex;
+    }
+
+    void compact()
+    {
+        indices.clear();
+        unsigned int maxIndices = (unsigned int)maxTexels;
+        for (int c = 0; c < clusterCount(); c++)
+        {
+            unsigned int count = std::min(clusterCounts[c], (unsigned int)MAX_LIGHTS_PER_CLUSTER);
+            if (count < clusterCounts[c] && !overflowReported)
+            {
+                std::cout << "WARNING::CLUSTERED_LIGHTS::CLUSTER_FULL: " << clusterCounts[c] << " lights touch one cluster, only " << MAX_LIGHTS_PER_CLUSTER << " are shaded" << std::endl;
+                overflowReported = true;
+            }
+            if (count > maxIndices - (unsigned int)indices.size())
+            {
+                count = maxIndices - (unsigned int)indices.size();
+                if (!overflowReported)
+                    std::cout << "WARNING::CLUSTERED_LIGHTS::INDEX_LIST_FULL: lights are dropped, GL_MAX_TEXTURE_BUFFER_SIZE is " << maxTexels << std::endl;
+                overflowReported = true;
+            }
+            grid[c * 2] = (unsigned int)indices.size();
+            grid[c * 2 + 1] = count;
+            indices.insert(indices.end(), clusterLights.begin() + c * MAX_LIGHTS_PER_CLUSTER, clusterLights.begin() + c * MAX_LIGHTS_PER_CLUSTER + count);
+        }
+        indexCount = (unsigned int)indices.size();
+    }
+
+    void upload()
+    {
+        // ClusteredLight is two vec4 texels, position+radius and color+intensity
+        uploadBuffer(buffers[0], Lights.empty() ? nullptr : &Lights[0], Lights.size() * sizeof(ClusteredLight));
+        uploadBuffer(buffers[1], &grid[0], grid.size() * sizeof(unsigned int));
+        uploadBuffer(buffers[2], indices.empty() ? nullptr : &indices[0], indices.size() * sizeof(unsigned int));
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    static void uploadBuffer(unsigned int buffer, const void* data, size_t size)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        // orphan the old storage so the driver does not wait for last frame's draws
+        glBufferData(GL_TEXTURE_BUFFER, std::max(size, (size_t)16), nullptr, GL_STREAM_DRAW);
+        if (size > 0)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+    }
+};
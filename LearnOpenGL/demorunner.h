@@ -0,0 +1,614 @@
+#pragma once
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+
+#ifdef LOGL_HEADLESS_EGL
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#ifdef LOGL_HEADLESS_OSMESA
+#include <GL/osmesa.h>
+#endif
+
+#include "camera.h"
+#include "pngwriter.h"
+#include "camerapath.h"
+#include "imagecompare.h"
+#include "gpuprofiler.h"
+#include "framestats.h"
+#include "gpumemory.h"
+#include "glhandle.h"
+#include "rendertargetpool.h"
+
+// Owns the GL context and the frame loop of a demo, so the same main() runs
+// interactively in a GLFW window or headless for automated benchmarks.
+//
+// LOGL_HEADLESS=<frames> renders that many frames without a display: the
+// context is a surfaceless EGL pbuffer when built with LOGL_HEADLESS_EGL (link
+// -lEGL), an OSMesa/llvmpipe buffer with LOGL_HEADLESS_OSMESA (link -lOSMesa),
+// and a hidden GLFW window otherwise or when those fail. Headless frames advance
+// time by a fixed 1/60 s and the camera follows a fixed script, so every run
+// renders the same images. At the end <name>_frames.csv (CPU and GPU time of
+// every frame) and <name>.png (the last frame) are written to
+// LOGL_HEADLESS_OUTPUT, or the working directory.
+//
+// The camera can be driven by a script in any mode, with fixed time steps:
+// LOGL_CAMERA_PATH=<file> flies along a keyframed spline (camerapath.h) and
+// LOGL_REPLAY_INPUT=<file> replays camera input that an interactive run
+// recorded with LOGL_RECORD_INPUT=<file>.
+//
+// Golden-image check: LOGL_GOLDEN=<dir> (headless) captures a pose at every
+// keyframe of the camera path, or the last frame without one, and compares
+// <name>_<pose>.png against the reference in <dir> (imagecompare.h). Failing
+// poses leave the frame and a _diff.png in the output directory and make
+// ExitCode() 1. Missing references are written, LOGL_GOLDEN_UPDATE rewrites all.
+//
+// LOGL_PROFILE turns on the PROFILE_GPU scopes (gpuprofiler.h) and prints their
+// table every PROFILE_REPORT_FRAMES frames, LOGL_PROFILE_TRACE=<file> also writes
+// a Chrome trace at exit.
+//
+// LOGL_FRAME_STATS counts the GL calls of every frame (framestats.h) and shows
+// them in the window title; LOGL_FRAME_STATS_CSV=<file> also logs them as csv,
+// headless runs log to <name>_stats.csv in the output directory without it.
+//
+// LOGL_GPU_MEMORY accounts every buffer, texture and render target (gpumemory.h)
+// and prints the largest after the first frame and on F12, and any left at exit;
+// LOGL_GPU_MEMORY_BUDGET_MB=<MiB> warns when the total grows past it.
+//
+// Targets() pools the demos' offscreen framebuffers (rendertargetpool.h).
+// GL objects dropped through glhandle.h are freed at EndFrame once the GPU has
+// finished with them, and all at once when the runner goes away.
+//
+// Linux build of a demo, e.g.:
+//   g++ -std=c++14 -O2 -DLOGL_HEADLESS_EGL -IIncludes MainDepthMap.cpp glad.c -lglfw -lEGL -ldl -lpthread
+class DemoRunner
+{
+public:
+    DemoRunner(const char* name, int width, int height) : name(name), width(width), height(height)
+    {
+        const char* frames = getenv("LOGL_HEADLESS");
+        headless = frames != nullptr;
+        if (headless)
+        {
+            frameCount = atoi(frames);
+            if (frameCount <= 0)
+                frameCount = DEFAULT_FRAMES;
+            const char* output = getenv("LOGL_HEADLESS_OUTPUT");
+            outputDirectory = output != nullptr ? output : ".";
+        }
+
+        const char* pathFile = getenv("LOGL_CAMERA_PATH");
+        if (pathFile != nullptr)
+            cameraPath.Load(pathFile);
+        const char* replayFile = getenv("LOGL_REPLAY_INPUT");
+        replaying = replayFile != nullptr && inputLog.Load(replayFile);
+        const char* recordFile = getenv("LOGL_RECORD_INPUT");
+        if (recordFile != nullptr && !headless && cameraPath.Empty() && !replaying)
+            recordPath = recordFile;
+
+        const char* golden = getenv("LOGL_GOLDEN");
+        if (golden != nullptr && headless)
+        {
+            goldenDirectory = golden;
+            goldenUpdate = getenv("LOGL_GOLDEN_UPDATE") != nullptr;
+            for (size_t i = 0; i < cameraPath.KeyCount(); i++)
+                poseFrames.push_back((int)std::lround(cameraPath.KeyTime(i) / FIXED_STEP));
+            if (poseFrames.empty())
+                poseFrames.push_back(frameCount - 1);
+            // render long enough to reach every pose
+            frameCount = std::max(frameCount, poseFrames.back() + 1);
+        }
+
+        if (headless)
+            ok = createEgl() || createOsMesa();
+        if (!ok)
+            ok = createGlfw();
+        if (!ok)
+            return;
+
+        const char* trace = getenv("LOGL_PROFILE_TRACE");
+        if (getenv("LOGL_PROFILE") != nullptr || trace != nullptr)
+            GpuProfiler::Get().Enable(trace);
+        const char* statsCsv = getenv("LOGL_FRAME_STATS_CSV");
+        if (getenv("LOGL_FRAME_STATS") != nullptr || statsCsv != nullptr)
+        {
+            FrameStats::Install();
+            if (statsCsv != nullptr)
+                FrameStats::OpenLog(statsCsv);
+            else if (headless)
+                FrameStats::OpenLog(outputDirectory + "/" + this->name + "_stats.csv");
+        }
+        const char* budget = getenv("LOGL_GPU_MEMORY_BUDGET_MB");
+        if (getenv("LOGL_GPU_MEMORY") != nullptr || budget != nullptr)
+            GpuMemory::Install(budget != nullptr ? (unsigned long long)(atof(budget) * 1024.0 * 1024.0) : 0);
+
+        if (headless)
+        {
+            queries.resize(frameCount * 2);
+            glGenQueries((GLsizei)queries.size(), queries.data());
+            cpuMs.reserve(frameCount);
+            std::cout << "HEADLESS:: " << frameCount << " frames of " << name << " at " << width << "x" << height
+                << " on " << glGetString(GL_RENDERER) << std::endl;
+        }
+    }
+
+    ~DemoRunner()
+    {
+        if (!recordPath.empty() && inputLog.Save(recordPath))
+            std::cout << "CAMERA_INPUT:: recorded " << inputLog.EventCount() << " events over " << frame << " frames to " << recordPath << std::endl;
+        if (ok)
+        {
+            GpuProfiler::Get().Shutdown();
+            targets.Clear();
+            GLDeletionQueue::Shutdown();
+        }
+        // the demo's objects are gone by now, whatever is left leaked
+        if (GpuMemory::Installed() && GpuMemory::TotalBytes() > 0)
+            std::cout << "GPU_MEMORY:: still allocated at exit\n" << GpuMemory::Report();
+        if (ok && headless && !queries.empty())
+            glDeleteQueries((GLsizei)queries.size(), queries.data());
+#ifdef LOGL_HEADLESS_EGL
+        if (eglDisplay != EGL_NO_DISPLAY)
+        {
+            eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (eglContext != EGL_NO_CONTEXT)
+                eglDestroyContext(eglDisplay, eglContext);
+            if (eglSurface != EGL_NO_SURFACE)
+                eglDestroySurface(eglDisplay, eglSurface);
+            eglTerminate(eglDisplay);
+        }
+#endif
+#ifdef LOGL_HEADLESS_OSMESA
+        if (osMesaContext != nullptr)
+            OSMesaDestroyContext(osMesaContext);
+#endif
+        if (glfwInitialized)
+            glfwTerminate();
+    }
+
+    // process exit code, 1 when a golden-image comparison failed
+    int ExitCode() const
+    {
+        return goldenFailures > 0 ? 1 : 0;
+    }
+
+    // the context is current and GL functions are loaded
+    bool Ok() const
+    {
+        return ok;
+    }
+
+    bool Headless() const
+    {
+        return headless;
+    }
+
+    // the user drives the camera through a visible window, otherwise UpdateCamera does
+    bool Interactive() const
+    {
+        return !headless && window != nullptr && cameraPath.Empty() && !replaying;
+    }
+
+    // nullptr unless the context belongs to a GLFW window
+    GLFWwindow* Window() const
+    {
+        return window;
+    }
+
+    // loop condition, starts the timing of a frame
+    bool Running()
+    {
+        if (!headless)
+        {
+            if (glfwWindowShouldClose(window))
+                return false;
+            GpuProfiler::Get().BeginFrame();
+            return true;
+        }
+        if (frame >= frameCount)
+        {
+            finish();
+            return false;
+        }
+        frameStart = std::chrono::steady_clock::now();
+        glQueryCounter(queries[frame * 2], GL_TIMESTAMP);
+        GpuProfiler::Get().BeginFrame();
+        return true;
+    }
+
+    // presents the frame, or records its timings when headless
+    void EndFrame()
+    {
+        GpuProfiler& profiler = GpuProfiler::Get();
+        profiler.EndFrame();
+        targets.EndFrame();
+        GLDeletionQueue::EndFrame();
+        if (profiler.Enabled() && (frame + 1) % PROFILE_REPORT_FRAMES == 0)
+            std::cout << profiler.TakeTable();
+        if (FrameStats::Installed())
+        {
+            FrameStats::EndFrame();
+            if (window != nullptr && frame % STATS_TITLE_FRAMES == 0)
+                glfwSetWindowTitle(window, (title + " | " + FrameStats::Summary(FrameStats::Last())).c_str());
+        }
+        if (GpuMemory::Installed())
+        {
+            bool reportKey = window != nullptr && glfwGetKey(window, GLFW_KEY_F12) == GLFW_PRESS;
+            if (frame == 0 || (reportKey && !reportKeyDown))
+                std::cout << GpuMemory::Report();
+            reportKeyDown = reportKey;
+        }
+        if (!headless)
+        {
+            glfwSwapBuffers(window);
+            // input arriving from here on belongs to the next frame
+            frame++;
+            inputLog.SetFrame(frame);
+            glfwPollEvents();
+            return;
+        }
+        glQueryCounter(queries[frame * 2 + 1], GL_TIMESTAMP);
+        for (size_t i = 0; i < poseFrames.size(); i++)
+            if (poseFrames[i] == frame)
+                checkGolden((int)i);
+        if (frame == frameCount - 1)
+            capture();
+        cpuMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+        frame++;
+    }
+
+    // ends the loop after the current frame
+    void Stop()
+    {
+        if (headless)
+            frameCount = frame + 1;
+        else
+            glfwSetWindowShouldClose(window, true);
+    }
+
+    // seconds since start, advancing exactly FIXED_STEP per frame when headless or scripted
+    float Time() const
+    {
+        return FixedStep() ? frame * FIXED_STEP : static_cast<float>(glfwGetTime());
+    }
+
+    bool FixedStep() const
+    {
+        return headless || !cameraPath.Empty() || replaying;
+    }
+
+    void FramebufferSize(int* framebufferWidth, int* framebufferHeight) const
+    {
+        if (headless)
+        {
+            *framebufferWidth = width;
+            *framebufferHeight = height;
+        }
+        else
+            glfwGetFramebufferSize(window, framebufferWidth, framebufferHeight);
+    }
+
+    void SetTitle(const std::string& title)
+    {
+        this->title = title;
+        if (window != nullptr && !FrameStats::Installed())
+            glfwSetWindowTitle(window, title.c_str());
+    }
+
+    // transient framebuffers, returned to the pool at EndFrame
+    RenderTargetPool& Targets()
+    {
+        return targets;
+    }
+
+    void SetSwapInterval(int interval)
+    {
+        if (window != nullptr)
+            glfwSwapInterval(interval);
+    }
+
+    // call every frame before processing input: follows the camera path or the replay,
+    // records the user's input, or headless without either runs the default script
+    void UpdateCamera(Camera& camera)
+    {
+        if (!cameraPath.Empty())
+            cameraPath.Apply(Time(), camera);
+        else if (replaying)
+            inputLog.Replay(frame, camera);
+        else if (!recordPath.empty())
+            camera.InputListener = &inputLog;
+        else if (headless)
+            sweepCamera(camera);
+    }
+
+private:
+    static const int DEFAULT_FRAMES = 300;
+    static constexpr float FIXED_STEP = 1.0f / 60.0f;
+    static const int PROFILE_REPORT_FRAMES = 300;
+    static const int STATS_TITLE_FRAMES = 30;
+    // golden images: per-channel noise allowed, share of pixels allowed beyond it, minimum SSIM
+    static const int GOLDEN_TOLERANCE = 8;
+    static constexpr double GOLDEN_MAX_OVER_TOLERANCE = 0.001;
+    static constexpr double GOLDEN_MIN_SSIM = 0.99;
+
+    std::string name;
+    int width, height;
+    bool ok = false;
+    bool headless = false;
+    bool glfwInitialized = false;
+    GLFWwindow* window = nullptr;
+    std::string title = "LearnOpenGL";
+    RenderTargetPool targets;
+    bool reportKeyDown = false;
+
+    int frameCount = 0;
+    int frame = 0;
+    bool finished = false;
+    std::string outputDirectory;
+    std::vector<GLuint> queries;
+    std::vector<double> cpuMs;
+    std::chrono::steady_clock::time_point frameStart;
+
+    CameraPath cameraPath;
+    CameraInputLog inputLog;
+    bool replaying = false;
+    std::string recordPath;
+
+    std::string goldenDirectory;
+    bool goldenUpdate = false;
+    std::vector<int> poseFrames;
+    int goldenFailures = 0, goldenWritten = 0;
+
+    bool scriptStarted = false;
+    glm::vec3 scriptPosition, scriptFront;
+    float scriptYaw = 0.0f, scriptPitch = 0.0f;
+
+    // from the demo's starting view, sweep the view 30 degrees left and right and
+    // dolly 1 unit along the starting direction, over 8 seconds
+    void sweepCamera(Camera& camera)
+    {
+        if (!scriptStarted)
+        {
+            scriptPosition = camera.Position;
+            scriptFront = camera.Front;
+            scriptYaw = camera.Yaw;
+            scriptPitch = camera.Pitch;
+            scriptStarted = true;
+        }
+        float phase = 2.0f * glm::pi<float>() * Time() / 8.0f;
+        camera.SetView(scriptPosition + scriptFront * std::sin(phase), scriptYaw + 30.0f * std::sin(phase), scriptPitch, camera.Fov);
+    }
+
+#ifdef LOGL_HEADLESS_EGL
+    EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+    EGLSurface eglSurface = EGL_NO_SURFACE;
+    EGLContext eglContext = EGL_NO_CONTEXT;
+#endif
+#ifdef LOGL_HEADLESS_OSMESA
+    OSMesaContext osMesaContext = nullptr;
+    std::vector<unsigned char> osMesaBuffer;
+#endif
+
+    bool createEgl()
+    {
+#ifdef LOGL_HEADLESS_EGL
+        // Mesa's surfaceless platform needs neither a display server nor a GPU
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay != nullptr)
+            eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (eglDisplay == EGL_NO_DISPLAY)
+            eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        EGLint major, minor;
+        if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor))
+        {
+            std::cout << "WARNING::HEADLESS:: EGL display could not be initialized" << std::endl;
+            eglDisplay = EGL_NO_DISPLAY;
+            return false;
+        }
+
+        const EGLint configAttributes[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+            EGL_DEPTH_SIZE, 24, EGL_STENCIL_SIZE, 8,
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint configCount = 0;
+        if (!eglChooseConfig(eglDisplay, configAttributes, &config, 1, &configCount) || configCount == 0)
+        {
+            std::cout << "WARNING::HEADLESS:: no EGL config with a pbuffer and OpenGL" << std::endl;
+            return false;
+        }
+        const EGLint surfaceAttributes[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+        eglSurface = eglCreatePbufferSurface(eglDisplay, config, surfaceAttributes);
+
+        const EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        eglBindAPI(EGL_OPENGL_API);
+        eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttributes);
+        if (eglSurface == EGL_NO_SURFACE || eglContext == EGL_NO_CONTEXT || !eglMakeCurrent(eglDisplay, eglSurface, eglSurface, eglContext))
+        {
+            std::cout << "WARNING::HEADLESS:: EGL OpenGL 3.3 core context could not be created" << std::endl;
+            return false;
+        }
+        return loadGl((GLADloadproc)eglGetProcAddress);
+#else
+        return false;
+#endif
+    }
+
+    bool createOsMesa()
+    {
+#ifdef LOGL_HEADLESS_OSMESA
+        const int attributes[] = {
+            OSMESA_FORMAT, OSMESA_RGBA,
+            OSMESA_DEPTH_BITS, 24,
+            OSMESA_STENCIL_BITS, 8,
+            OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+            OSMESA_CONTEXT_MAJOR_VERSION, 3,
+            OSMESA_CONTEXT_MINOR_VERSION, 3,
+            0
+        };
+        osMesaContext = OSMesaCreateContextAttribs(attributes, nullptr);
+        osMesaBuffer.resize((size_t)width * height * 4);
+        if (osMesaContext == nullptr || !OSMesaMakeCurrent(osMesaContext, osMesaBuffer.data(), GL_UNSIGNED_BYTE, width, height))
+        {
+            std::cout << "WARNING::HEADLESS:: OSMesa OpenGL 3.3 core context could not be created" << std::endl;
+            return false;
+        }
+        return loadGl((GLADloadproc)OSMesaGetProcAddress);
+#else
+        return false;
+#endif
+    }
+
+    bool createGlfw()
+    {
+        glfwInit();
+        glfwInitialized = true;
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        if (headless)
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+#ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+        window = glfwCreateWindow(width, height, "LearnOpenGL", NULL, NULL);
+        if (window == NULL)
+        {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            return false;
+        }
+        glfwMakeContextCurrent(window);
+        if (!loadGl((GLADloadproc)glfwGetProcAddress))
+            return false;
+        if (headless)
+            glfwSwapInterval(0);
+        return true;
+    }
+
+    bool loadGl(GLADloadproc loader)
+    {
+        if (!gladLoadGLLoader(loader))
+        {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // the default framebuffer, top row first
+    Image readFrame()
+    {
+        Image image;
+        image.Width = width;
+        image.Height = height;
+        std::vector<unsigned char> rows((size_t)width * height * 4);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rows.data());
+        image.Pixels.resize(rows.size());
+        size_t rowSize = (size_t)width * 4;
+        for (int y = 0; y < height; y++)
+            std::copy(rows.begin() + rowSize * (height - 1 - y), rows.begin() + rowSize * (height - y), image.Pixels.begin() + rowSize * y);
+        return image;
+    }
+
+    // the last frame, read before anything else draws
+    void capture()
+    {
+        std::string path = outputDirectory + "/" + name + ".png";
+        if (!ImageCompare::Save(path, readFrame()))
+            std::cout << "ERROR::HEADLESS:: could not write " << path << std::endl;
+    }
+
+    void checkGolden(int pose)
+    {
+        Image image = readFrame();
+        std::string file = name + "_" + std::to_string(pose);
+        std::string goldenPath = goldenDirectory + "/" + file + ".png";
+        Image reference;
+        if (goldenUpdate || !ImageCompare::Load(goldenPath, reference))
+        {
+            if (ImageCompare::Save(goldenPath, image))
+                goldenWritten++;
+            else
+                std::cout << "ERROR::GOLDEN:: could not write " << goldenPath << std::endl;
+            return;
+        }
+
+        Image diff;
+        ImageCompare::Result result = ImageCompare::Compare(image, reference, GOLDEN_TOLERANCE, &diff);
+        bool pass = result.SizeMatches && result.OverToleranceFraction <= GOLDEN_MAX_OVER_TOLERANCE && result.Ssim >= GOLDEN_MIN_SSIM;
+        std::cout << "GOLDEN::" << (pass ? "PASS " : "FAIL ") << file;
+        if (result.SizeMatches)
+        {
+            std::ostringstream stats;
+            stats << std::fixed << std::setprecision(4) << ": ssim " << result.Ssim << ", " << result.OverToleranceFraction * 100.0
+                << "% pixels beyond tolerance, max difference " << result.MaxDifference;
+            std::cout << stats.str();
+        }
+        else
+            std::cout << ": size " << image.Width << "x" << image.Height << " differs from " << reference.Width << "x" << reference.Height;
+        std::cout << std::endl;
+        if (pass)
+            return;
+        goldenFailures++;
+        ImageCompare::Save(outputDirectory + "/" + file + ".png", image);
+        if (result.SizeMatches)
+            ImageCompare::Save(outputDirectory + "/" + file + "_diff.png", diff);
+    }
+
+    // waits for the GPU timestamps, writes the csv and prints the averages
+    void finish()
+    {
+        if (finished)
+            return;
+        finished = true;
+
+        std::string path = outputDirectory + "/" + name + "_frames.csv";
+        std::ofstream csv(path.c_str());
+        if (!csv)
+            std::cout << "ERROR::HEADLESS:: could not write " << path << std::endl;
+        csv << "frame,cpu_ms,gpu_ms\n";
+        double cpuTotal = 0.0, gpuTotal = 0.0;
+        for (int i = 0; i < (int)cpuMs.size(); i++)
+        {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(queries[i * 2], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+            double gpuMs = (end - begin) / 1000000.0;
+            csv << i << "," << cpuMs[i] << "," << gpuMs << "\n";
+            cpuTotal += cpuMs[i];
+            gpuTotal += gpuMs;
+        }
+
+        int frames = std::max((int)cpuMs.size(), 1);
+        std::cout << "HEADLESS:: " << cpuMs.size() << " frames, cpu " << cpuTotal / frames << " ms, gpu "
+            << gpuTotal / frames << " ms per frame, wrote " << path << std::endl;
+        if (!poseFrames.empty())
+            std::cout << "GOLDEN:: " << poseFrames.size() << " poses, " << goldenFailures << " failed, " << goldenWritten
+                << " reference(s) written to " << goldenDirectory << std::endl;
+    }
+};
@@ -0,0 +1,45 @@
+// depth convention of the application, ReverseZ::Defines() (reversez.h) sets both switches
+#ifndef REVERSE_Z
+#define REVERSE_Z 0
+#endif
+#ifndef DEPTH_ZERO_TO_ONE
+#define DEPTH_ZERO_TO_ONE 0
+#endif
+
+// clip space z of the far plane at w = 1, e.g. gl_Position = vec4(pos.xy, FAR_CLIP_Z * pos.w, pos.w)
+#if !REVERSE_Z
+#define FAR_CLIP_Z 1.0
+#elif DEPTH_ZERO_TO_ONE
+#define FAR_CLIP_Z 0.0
+#else
+#define FAR_CLIP_Z -1.0
+#endif
+
+// depth buffer value of a normalized device z
+float NdcToDepth(float z)
+{
+#if DEPTH_ZERO_TO_ONE
+	return z;
+#else
+	return z * 0.5 + 0.5;
+#endif
+}
+
+// moves a depth value towards the viewer by amount
+float DepthTowardsViewer(float depth, float amount)
+{
+#if REVERSE_Z
+	return depth + amount;
+#else
+	return depth - amount;
+#endif
+}
+
+bool IsBeyondFarPlane(float depth)
+{
+#if REVERSE_Z
+	return depth < 0.0;
+#else
+	return depth > 1.0;
+#endif
+}
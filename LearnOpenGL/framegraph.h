@@ -0,0 +1,410 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <iostream>
+
+#include "rendertargetpool.h"
+#include "gpuprofiler.h"
+
+// Declarative multi-pass frame. Every frame the demo adds its passes, each
+// with a setup callback declaring what it reads and writes and an execute
+// callback issuing the draws, then calls Execute(), which
+//  - culls passes that contribute nothing to the backbuffer or a SideEffect() pass,
+//  - orders the rest so every pass runs after the passes it depends on:
+//    the writers of what it reads (a pass reading a transient target declared
+//    ahead of its writer is moved behind it) and the earlier writers of what
+//    it writes; a pass overwriting what an earlier pass reads, such as a
+//    history target, runs after that reader,
+//  - acquires transient targets from the pool just before their first pass and
+//    releases them after their last, so targets of passes whose lifetimes do
+//    not overlap share memory,
+//  - binds each pass's framebuffer and viewport, skipping the bind when the
+//    previous pass rendered to the same one, and the textures it reads on the
+//    units it asked for, and times the pass with PROFILE_GPU.
+// A transient resource is a whole RenderTarget (color, velocity and depth) with
+// no content before its first writer. Imported render targets persist across
+// frames and are bound like transient ones; other imported objects (shadow maps
+// and the like) keep their own framebuffers, and passes writing them bind what
+// they need themselves.
+class FrameGraph
+{
+public:
+    typedef int Resource;
+    static const Resource BACKBUFFER = 0;
+
+    enum Attachment {
+        COLOR,
+        DEPTH,
+        VELOCITY
+    };
+
+    class PassBuilder
+    {
+    public:
+        // a transient target, written by this pass
+        Resource Create(const char* name, const RenderTargetDesc& desc)
+        {
+            Resource resource = graph.addResource(name);
+            graph.resources[resource].Desc = desc;
+            graph.resources[resource].Transient = true;
+            Write(resource);
+            return resource;
+        }
+
+        // unit >= 0 binds the attachment's texture there before the pass runs
+        void Read(Resource resource, int unit = -1, Attachment attachment = COLOR)
+        {
+            PassRead read = { resource, unit, attachment };
+            graph.passes[pass].Reads.push_back(read);
+        }
+
+        void Write(Resource resource)
+        {
+            graph.passes[pass].Writes.push_back(resource);
+        }
+
+        // keeps the pass even when nothing reads what it writes
+        void SideEffect()
+        {
+            graph.passes[pass].SideEffect = true;
+        }
+
+    private:
+        friend class FrameGraph;
+        PassBuilder(FrameGraph& graph, int pass) : graph(graph), pass(pass)
+        {
+        }
+
+        FrameGraph& graph;
+        int pass;
+    };
+
+    typedef std::function<void(PassBuilder&)> Setup;
+    typedef std::function<void()> Run;
+
+    explicit FrameGraph(RenderTargetPool& pool) : pool(pool)
+    {
+        reset();
+    }
+
+    void SetBackbufferSize(int width, int height)
+    {
+        backbufferWidth = width;
+        backbufferHeight = height;
+    }
+
+    // an object owned outside the graph, texture is what readers bind
+    Resource Import(const char* name, GLuint texture, GLenum textureTarget = GL_TEXTURE_2D)
+    {
+        Resource resource = addResource(name);
+        resources[resource].ImportedTexture = texture;
+        resources[resource].TextureTarget = textureTarget;
+        return resource;
+    }
+
+    // a render target owned outside the graph, e.g. one kept across frames
+    Resource Import(const char* name, RenderTarget& target)
+    {
+        Resource resource = addResource(name);
+        resources[resource].Target = &target;
+        return resource;
+    }
+
+    void AddPass(const char* name, const Setup& setup, const Run& run)
+    {
+        Pass pass;
+        pass.Name = name;
+        pass.Execute = run;
+        passes.push_back(pass);
+        PassBuilder builder(*this, (int)passes.size() - 1);
+        setup(builder);
+    }
+
+    // the target of a transient or imported target resource, transient ones are valid while the passes using it run
+    RenderTarget& Target(Resource resource) const
+    {
+        return *resources[resource].Target;
+    }
+
+    GLuint Texture(Resource resource, Attachment attachment = COLOR) const
+    {
+        const ResourceEntry& entry = resources[resource];
+        if (entry.Target == nullptr)
+            return entry.ImportedTexture;
+        switch (attachment)
+        {
+        case DEPTH: return entry.Target->DepthTexture;
+        case VELOCITY: return entry.Target->VelocityTexture;
+        default: return entry.Target->ColorTexture;
+        }
+    }
+
+    // compiles and runs the passes added since the last call, then forgets them
+    void Execute()
+    {
+        std::vector<int> order = compile();
+        std::vector<int> firstUse(resources.size(), -1), lastUse(resources.size(), -1);
+        for (int i = 0; i < (int)order.size(); i++)
+        {
+            const Pass& pass = passes[order[i]];
+            for (const PassRead& read : pass.Reads)
+                use(read.Input, i, firstUse, lastUse);
+            for (Resource resource : pass.Writes)
+                use(resource, i, firstUse, lastUse);
+        }
+
+        GLuint boundFramebuffer = UNKNOWN_FRAMEBUFFER;
+        for (int i = 0; i < (int)order.size(); i++)
+        {
+            Pass& pass = passes[order[i]];
+            for (size_t r = 0; r < resources.size(); r++)
+                if (firstUse[r] == i && resources[r].Transient)
+                    resources[r].Target = &pool.Acquire(resources[r].Desc);
+
+            GpuProfileScope scope(pass.Name);
+            bindTarget(pass, boundFramebuffer);
+            for (const PassRead& read : pass.Reads)
+            {
+                if (read.Unit < 0)
+                    continue;
+                glActiveTexture(GL_TEXTURE0 + read.Unit);
+                glBindTexture(resources[read.Input].TextureTarget, Texture(read.Input, read.Attachment));
+            }
+            glActiveTexture(GL_TEXTURE0);
+            pass.Execute();
+
+            for (size_t r = 0; r < resources.size(); r++)
+            {
+                if (lastUse[r] == i && resources[r].Transient)
+                {
+                    pool.Release(*resources[r].Target);
+                    resources[r].Target = nullptr;
+                }
+            }
+        }
+        reset();
+    }
+
+private:
+    // no framebuffer is known to be bound, the next pass binds its own
+    static const GLuint UNKNOWN_FRAMEBUFFER = ~0u;
+
+    struct PassRead {
+        Resource Input;
+        int Unit;
+        FrameGraph::Attachment Attachment;
+    };
+
+    struct Pass {
+        const char* Name;
+        Run Execute;
+        std::vector<PassRead> Reads;
+        std::vector<Resource> Writes;
+        bool SideEffect = false;
+    };
+
+    struct ResourceEntry {
+        std::string Name;
+        bool Transient = false;
+        RenderTargetDesc Desc;
+        RenderTarget* Target = nullptr;
+        GLuint ImportedTexture = 0;
+        GLenum TextureTarget = GL_TEXTURE_2D;
+    };
+
+    RenderTargetPool& pool;
+    std::vector<Pass> passes;
+    std::vector<ResourceEntry> resources;
+    int backbufferWidth = 0, backbufferHeight = 0;
+    std::string lastPlan;
+
+    void reset()
+    {
+        passes.clear();
+        resources.clear();
+        addResource("backbuffer");
+    }
+
+    Resource addResource(const char* name)
+    {
+        ResourceEntry entry;
+        entry.Name = name;
+        resources.push_back(entry);
+        return (Resource)resources.size() - 1;
+    }
+
+    static void use(Resource resource, int index, std::vector<int>& firstUse, std::vector<int>& lastUse)
+    {
+        if (firstUse[resource] < 0)
+            firstUse[resource] = index;
+        lastUse[resource] = index;
+    }
+
+    bool writes(const Pass& pass, Resource resource) const
+    {
+        for (Resource written : pass.Writes)
+            if (written == resource)
+                return true;
+        return false;
+    }
+
+    bool writtenBefore(Resource resource, int pass) const
+    {
+        for (int other = 0; other < pass; other++)
+            if (writes(passes[other], resource))
+                return true;
+        return false;
+    }
+
+    bool reads(const Pass& pass, Resource resource) const
+    {
+        for (const PassRead& read : pass.Reads)
+            if (read.Input == resource)
+                return true;
+        return false;
+    }
+
+    // does pass need the output of other: it reads what other wrote before it, or draws over
+    // it. A transient resource has no content before its first writer, so reading one that is
+    // only written later waits for that writer
+    bool needs(int pass, int other) const
+    {
+        for (const PassRead& read : passes[pass].Reads)
+        {
+            if (!writes(passes[other], read.Input))
+                continue;
+            if (other < pass || (resources[read.Input].Transient && !writtenBefore(read.Input, pass)))
+                return true;
+        }
+        for (Resource resource : passes[pass].Writes)
+            if (other < pass && writes(passes[other], resource))
+                return true;
+        return false;
+    }
+
+    // must pass wait for other without needing it: other reads the earlier content of a
+    // resource pass overwrites, e.g. last frame's history
+    bool after(int pass, int other) const
+    {
+        if (other > pass)
+            return false;
+        for (Resource resource : passes[pass].Writes)
+            if (reads(passes[other], resource) && !needs(other, pass))
+                return true;
+        return false;
+    }
+
+    // the live passes in execution order
+    std::vector<int> compile()
+    {
+        int count = (int)passes.size();
+        std::vector<std::vector<int>> inputs(count), predecessors(count);
+        for (int p = 0; p < count; p++)
+        {
+            for (int other = 0; other < count; other++)
+            {
+                if (other == p)
+                    continue;
+                if (needs(p, other))
+                    inputs[p].push_back(other);
+                if (needs(p, other) || after(p, other))
+                    predecessors[p].push_back(other);
+            }
+        }
+
+        // cull: keep what the backbuffer and the side effects need
+        std::vector<bool> live(count, false);
+        std::vector<int> stack;
+        for (int p = 0; p < count; p++)
+        {
+            if (passes[p].SideEffect || writes(passes[p], BACKBUFFER))
+            {
+                live[p] = true;
+                stack.push_back(p);
+            }
+        }
+        while (!stack.empty())
+        {
+            int p = stack.back();
+            stack.pop_back();
+            for (int input : inputs[p])
+            {
+                if (!live[input])
+                {
+                    live[input] = true;
+                    stack.push_back(input);
+                }
+            }
+        }
+
+        // order: the first live pass in declaration order whose predecessors have all run
+        std::vector<int> order;
+        std::vector<bool> done(count, false);
+        while (true)
+        {
+            int next = -1;
+            for (int p = 0; p < count && next < 0; p++)
+            {
+                if (!live[p] || done[p])
+                    continue;
+                bool ready = true;
+                for (int input : predecessors[p])
+                    ready = ready && (done[input] || !live[input]);
+                if (ready)
+                    next = p;
+            }
+            if (next < 0)
+                break;
+            done[next] = true;
+            order.push_back(next);
+        }
+
+        std::string plan;
+        for (int p : order)
+            plan += (plan.empty() ? "" : " -> ") + std::string(passes[p].Name);
+        std::string culled;
+        for (int p = 0; p < count; p++)
+        {
+            if (!live[p])
+                culled += (culled.empty() ? "" : ", ") + std::string(passes[p].Name);
+            else if (!done[p])
+                std::cout << "ERROR::FRAME_GRAPH:: pass " << passes[p].Name << " is part of a cycle and was skipped" << std::endl;
+        }
+        if (!culled.empty())
+            plan += " (culled " + culled + ")";
+        if (plan != lastPlan)
+            std::cout << "FRAME_GRAPH:: " << plan << std::endl;
+        lastPlan = plan;
+        return order;
+    }
+
+    void bindTarget(const Pass& pass, GLuint& boundFramebuffer) const
+    {
+        for (Resource resource : pass.Writes)
+        {
+            const ResourceEntry& entry = resources[resource];
+            GLuint framebuffer;
+            if (resource == BACKBUFFER)
+                framebuffer = 0;
+            else if (entry.Target != nullptr)
+                framebuffer = entry.Target->FBO;
+            else
+                continue;
+            if (framebuffer != boundFramebuffer)
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+                if (resource == BACKBUFFER)
+                    glViewport(0, 0, backbufferWidth, backbufferHeight);
+                else
+                    glViewport(0, 0, entry.Target->Desc.Width, entry.Target->Desc.Height);
+                boundFramebuffer = framebuffer;
+            }
+            return;
+        }
+        // the pass renders to imported objects and binds them itself
+        boundFramebuffer = UNKNOWN_FRAMEBUFFER;
+    }
+};
@@ -0,0 +1,324 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+// per frame counts of the GL work a demo submits
+struct FrameCounters {
+    unsigned long long DrawCalls = 0;
+    unsigned long long Instances = 0;
+    unsigned long long Triangles = 0;
+    unsigned long long ProgramBinds = 0;
+    unsigned long long VertexArrayBinds = 0;
+    unsigned long long TextureBinds = 0;
+    unsigned long long UniformUpdates = 0;
+    unsigned long long BufferUploadBytes = 0;
+    unsigned long long TextureUploadBytes = 0;
+    unsigned long long FramebufferBinds = 0;
+};
+
+// Counts draw calls, instances, triangles, binds, uniform updates, uploads and
+// framebuffer switches. Install() swaps glad's function pointers for counting
+// wrappers, so every call is seen, from Mesh::Draw, Shader::set* and the demo
+// loops alike, without touching the call sites; until then nothing is counted
+// and nothing costs. DemoRunner installs it with LOGL_FRAME_STATS, shows the
+// last frame in the window title and logs every frame to LOGL_FRAME_STATS_CSV=<csv>.
+class FrameStats
+{
+public:
+    // call once glad is loaded
+    static void Install()
+    {
+        State& s = state();
+        if (s.installed)
+            return;
+        s.installed = true;
+#define FRAME_STATS_HOOK(name) s.name = glad_gl##name; glad_gl##name = count##name
+        FRAME_STATS_HOOK(DrawArrays);
+        FRAME_STATS_HOOK(DrawElements);
+        FRAME_STATS_HOOK(DrawArraysInstanced);
+        FRAME_STATS_HOOK(DrawElementsInstanced);
+        FRAME_STATS_HOOK(UseProgram);
+        FRAME_STATS_HOOK(BindVertexArray);
+        FRAME_STATS_HOOK(BindTexture);
+        FRAME_STATS_HOOK(BindFramebuffer);
+        FRAME_STATS_HOOK(BufferData);
+        FRAME_STATS_HOOK(BufferSubData);
+        FRAME_STATS_HOOK(TexImage2D);
+        FRAME_STATS_HOOK(TexSubImage2D);
+        FRAME_STATS_HOOK(TexImage3D);
+        FRAME_STATS_HOOK(Uniform1i);
+        FRAME_STATS_HOOK(Uniform1f);
+        FRAME_STATS_HOOK(Uniform2f);
+        FRAME_STATS_HOOK(Uniform3f);
+        FRAME_STATS_HOOK(Uniform3fv);
+        FRAME_STATS_HOOK(Uniform4fv);
+        FRAME_STATS_HOOK(UniformMatrix3fv);
+        FRAME_STATS_HOOK(UniformMatrix4fv);
+#undef FRAME_STATS_HOOK
+    }
+
+    static bool Installed()
+    {
+        return state().installed;
+    }
+
+    // writes a csv row per frame from now on
+    static bool OpenLog(const std::string& path)
+    {
+        State& s = state();
+        s.log.open(path.c_str());
+        if (!s.log)
+        {
+            std::cout << "ERROR::FRAME_STATS:: could not write " << path << std::endl;
+            return false;
+        }
+        s.log << "frame,draw_calls,instances,triangles,program_binds,vao_binds,texture_binds,uniform_updates,buffer_upload_bytes,texture_upload_bytes,fbo_binds\n";
+        return true;
+    }
+
+    // counts of the last finished frame
+    static const FrameCounters& Last()
+    {
+        return state().last;
+    }
+
+    // closes the frame: its counts become Last() and go to the log
+    static void EndFrame()
+    {
+        State& s = state();
+        if (!s.installed)
+            return;
+        s.last = s.current;
+        s.current = FrameCounters();
+        if (s.log.is_open())
+        {
+            const FrameCounters& c = s.last;
+            s.log << s.frame << "," << c.DrawCalls << "," << c.Instances << "," << c.Triangles << "," << c.ProgramBinds << ","
+                << c.VertexArrayBinds << "," << c.TextureBinds << "," << c.UniformUpdates << "," << c.BufferUploadBytes << ","
+                << c.TextureUploadBytes << "," << c.FramebufferBinds << "\n";
+        }
+        s.frame++;
+    }
+
+    // one line for the overlay
+    static std::string Summary(const FrameCounters& c)
+    {
+        std::ostringstream line;
+        line << c.DrawCalls << " draws, " << c.Instances << " instances, " << c.Triangles / 1000 << "k tris, "
+            << c.ProgramBinds << " programs, " << c.VertexArrayBinds << " vaos, " << c.TextureBinds << " textures, "
+            << c.UniformUpdates << " uniforms, " << (c.BufferUploadBytes + c.TextureUploadBytes) / 1024 << " KiB up, "
+            << c.FramebufferBinds << " fbos";
+        return line.str();
+    }
+
+private:
+    struct State {
+        bool installed = false;
+        FrameCounters current, last;
+        std::ofstream log;
+        unsigned int frame = 0;
+
+        PFNGLDRAWARRAYSPROC DrawArrays;
+        PFNGLDRAWELEMENTSPROC DrawElements;
+        PFNGLDRAWARRAYSINSTANCEDPROC DrawArraysInstanced;
+        PFNGLDRAWELEMENTSINSTANCEDPROC DrawElementsInstanced;
+        PFNGLUSEPROGRAMPROC UseProgram;
+        PFNGLBINDVERTEXARRAYPROC BindVertexArray;
+        PFNGLBINDTEXTUREPROC BindTexture;
+        PFNGLBINDFRAMEBUFFERPROC BindFramebuffer;
+        PFNGLBUFFERDATAPROC BufferData;
+        PFNGLBUFFERSUBDATAPROC BufferSubData;
+        PFNGLTEXIMAGE2DPROC TexImage2D;
+        PFNGLTEXSUBIMAGE2DPROC TexSubImage2D;
+        PFNGLTEXIMAGE3DPROC TexImage3D;
+        PFNGLUNIFORM1IPROC Uniform1i;
+        PFNGLUNIFORM1FPROC Uniform1f;
+        PFNGLUNIFORM2FPROC Uniform2f;
+        PFNGLUNIFORM3FPROC Uniform3f;
+        PFNGLUNIFORM3FVPROC Uniform3fv;
+        PFNGLUNIFORM4FVPROC Uniform4fv;
+        PFNGLUNIFORMMATRIX3FVPROC UniformMatrix3fv;
+        PFNGLUNIFORMMATRIX4FVPROC UniformMatrix4fv;
+    };
+
+    static State& state()
+    {
+        static State s;
+        return s;
+    }
+
+    static FrameCounters& current()
+    {
+        return state().current;
+    }
+
+    static unsigned long long triangles(GLenum mode, GLsizei count)
+    {
+        if (mode == GL_TRIANGLES)
+            return count / 3;
+        if ((mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN) && count > 2)
+            return count - 2;
+        return 0;
+    }
+
+    static void draw(GLenum mode, GLsizei count, GLsizei instances)
+    {
+        FrameCounters& c = current();
+        c.DrawCalls++;
+        c.Instances += instances;
+        c.Triangles += triangles(mode, count) * instances;
+    }
+
+    // bytes of a client-memory texture upload, 0 when no data is given
+    static unsigned long long texelBytes(GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels)
+    {
+        if (pixels == nullptr)
+            return 0;
+        unsigned long long channels = 4;
+        switch (format)
+        {
+        case GL_RED: case GL_DEPTH_COMPONENT: case GL_RED_INTEGER: channels = 1; break;
+        case GL_RG: case GL_DEPTH_STENCIL: case GL_RG_INTEGER: channels = 2; break;
+        case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: channels = 3; break;
+        }
+        unsigned long long size = 1;
+        switch (type)
+        {
+        case GL_SHORT: case GL_UNSIGNED_SHORT: case GL_HALF_FLOAT: size = 2; break;
+        case GL_INT: case GL_UNSIGNED_INT: case GL_FLOAT: size = 4; break;
+        case GL_UNSIGNED_INT_24_8: channels = 1; size = 4; break;
+        }
+        return (unsigned long long)width * height * depth * channels * size;
+    }
+
+    static void APIENTRY countDrawArrays(GLenum mode, GLint first, GLsizei count)
+    {
+        draw(mode, count, 1);
+        state().DrawArrays(mode, first, count);
+    }
+
+    static void APIENTRY countDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+    {
+        draw(mode, count, 1);
+        state().DrawElements(mode, count, type, indices);
+    }
+
+    static void APIENTRY countDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instancecount)
+    {
+        draw(mode, count, instancecount);
+        state().DrawArraysInstanced(mode, first, count, instancecount);
+    }
+
+    static void APIENTRY countDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount)
+    {
+        draw(mode, count, instancecount);
+        state().DrawElementsInstanced(mode, count, type, indices, instancecount);
+    }
+
+    static void APIENTRY countUseProgram(GLuint program)
+    {
+        current().ProgramBinds++;
+        state().UseProgram(program);
+    }
+
+    static void APIENTRY countBindVertexArray(GLuint array)
+    {
+        current().VertexArrayBinds++;
+        state().BindVertexArray(array);
+    }
+
+    static void APIENTRY countBindTexture(GLenum target, GLuint texture)
+    {
+        current().TextureBinds++;
+        state().BindTexture(target, texture);
+    }
+
+    static void APIENTRY countBindFramebuffer(GLenum target, GLuint framebuffer)
+    {
+        current().FramebufferBinds++;
+        state().BindFramebuffer(target, framebuffer);
+    }
+
+    static void APIENTRY countBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+    {
+        if (data != nullptr)
+            current().BufferUploadBytes += size;
+        state().BufferData(target, size, data, usage);
+    }
+
+    static void APIENTRY countBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+    {
+        current().BufferUploadBytes += size;
+        state().BufferSubData(target, offset, size, data);
+    }
+
+    static void APIENTRY countTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels)
+    {
+        current().TextureUploadBytes += texelBytes(width, height, 1, format, type, pixels);
+        state().TexImage2D(target, level, internalformat, width, height, border, format, type, pixels);
+    }
+
+    static void APIENTRY countTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels)
+    {
+        current().TextureUploadBytes += texelBytes(width, height, 1, format, type, pixels);
+        state().TexSubImage2D(target, level, xoffset, yoffset, width, height, format, type, pixels);
+    }
+
+    static void APIENTRY countTexImage3D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void* pixels)
+    {
+        current().TextureUploadBytes += texelBytes(width, height, depth, format, type, pixels);
+        state().TexImage3D(target, level, internalformat, width, height, depth, border, format, type, pixels);
+    }
+
+    static void APIENTRY countUniform1i(GLint location, GLint v0)
+    {
+        current().UniformUpdates++;
+        state().Uniform1i(location, v0);
+    }
+
+    static void APIENTRY countUniform1f(GLint location, GLfloat v0)
+    {
+        current().UniformUpdates++;
+        state().Uniform1f(location, v0);
+    }
+
+    static void APIENTRY countUniform2f(GLint location, GLfloat v0, GLfloat v1)
+    {
+        current().UniformUpdates++;
+        state().Uniform2f(location, v0, v1);
+    }
+
+    static void APIENTRY countUniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2)
+    {
+        current().UniformUpdates++;
+        state().Uniform3f(location, v0, v1, v2);
+    }
+
+    static void APIENTRY countUniform3fv(GLint location, GLsizei count, const GLfloat* value)
+    {
+        current().UniformUpdates++;
+        state().Uniform3fv(location, count, value);
+    }
+
+    static void APIENTRY countUniform4fv(GLint location, GLsizei count, const GLfloat* value)
+    {
+        current().UniformUpdates++;
+        state().Uniform4fv(location, count, value);
+    }
+
+    static void APIENTRY countUniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+    {
+        current().UniformUpdates++;
+        state().UniformMatrix3fv(location, count, transpose, value);
+    }
+
+    static void APIENTRY countUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+    {
+        current().UniformUpdates++;
+        state().UniformMatrix4fv(location, count, transpose, value);
+    }
+};
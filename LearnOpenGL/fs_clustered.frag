@@ -0,0 +1,27 @@
+#version 330 core
+out vec4 FragColor;
+
+#include "clustered.glsl"
+#include "normalmap.glsl"
+
+in vec2 TexCoords;
+in vec3 Normal;
+in vec3 VertPos;
+in float ViewDepth;
+
+uniform vec3 viewPos;
+uniform vec3 ambient;
+uniform sampler2D texture_diffuse1;
+
+void main()
+{
+	vec3 color = vec3(texture(texture_diffuse1, TexCoords));
+	vec3 norm = SurfaceNormal(Normal, TexCoords);
+	vec3 viewDir = normalize(viewPos - VertPos);
+
+	// only the lights assigned to this fragment's cluster are visited
+	vec3 result = ambient * color;
+	result += CalcClusteredLights(gl_FragCoord.xy, ViewDepth, VertPos, norm, viewDir, color, vec3(0.2), 32.0);
+
+	FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,38 @@
+#version 330 core
+out vec4 FragColor;
+
+#include "gbuffer.glsl"
+#include "clustered.glsl"
+
+in vec2 TexCoords;
+
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormalRoughness;
+uniform sampler2D gDepth;
+
+uniform mat4 inverseProjection;
+uniform mat4 inverseView;
+uniform vec3 viewPos;
+uniform vec3 ambient;
+
+void main()
+{
+	float depth = texture(gDepth, TexCoords).r;
+	if (depth == 1.0)
+		discard;	// nothing was drawn here
+
+	vec4 albedoSpecular = texture(gAlbedoSpecular, TexCoords);
+	vec4 normalRoughness = texture(gNormalRoughness, TexCoords);
+
+	vec3 viewPosition = ReconstructViewPosition(TexCoords, depth, inverseProjection);
+	vec3 vertPos = vec3(inverseView * vec4(viewPosition, 1.0));
+	vec3 norm = OctDecode(normalRoughness.rg);
+	vec3 viewDir = normalize(viewPos - vertPos);
+	vec3 color = albedoSpecular.rgb;
+
+	// the cluster grid doubles as the tile light list of the lighting pass
+	vec3 result = ambient * color;
+	result += CalcClusteredLights(gl_FragCoord.xy, -viewPosition.z, vertPos, norm, viewDir, color, vec3(albedoSpecular.a), ShininessFromRoughness(normalRoughness.b));
+
+	FragColor = vec4(result, 1.0);
+}
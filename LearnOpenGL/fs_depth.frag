@@ -1,28 +1,102 @@
 #version 330 core
 out vec4 FragColor;
 
+#include "depth.glsl"
+
+// permutation switch, SHADOWS=0 compiles the shadow lookup out entirely
+#ifndef SHADOWS
+#define SHADOWS 1
+#endif
+
+// permutation switch for the shadow kernel, every tap is a hardware-compared 2x2 PCF fetch
+//   0: one fetch
+//   1: 3x3 fetches one texel apart (4x4 texel footprint, tent weighted)
+//   2: 12 fetches on a Poisson disk rotated per pixel, noise instead of banding
+#ifndef SHADOW_FILTER
+#define SHADOW_FILTER 0
+#endif
+
 in VS_OUT {
     vec3 FragPos;
     vec3 Normal;
     vec2 TexCoords;
-    vec4 FragPosLightSpace;
 } fs_in;
 
+// one layer per cascade, see cascadedshadows.h
+#define MAX_CASCADES 4
+
 uniform sampler2D diffuseTexture;
-uniform sampler2D shadowMap;
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 lightSpaceMatrices[MAX_CASCADES];
+uniform float cascadeSplits[MAX_CASCADES];
+uniform int cascadeCount;
 
+uniform mat4 view;
 uniform vec3 lightPos;
 uniform vec3 viewPos;
 
-float ShadowCalculation(vec4 pos)
+#if SHADOW_FILTER == 2
+const vec2 poissonDisk[12] = vec2[](
+    vec2(-0.326, -0.406), vec2(-0.840, -0.074), vec2(-0.696,  0.457),
+    vec2(-0.203,  0.621), vec2( 0.962, -0.195), vec2( 0.473, -0.480),
+    vec2( 0.519,  0.767), vec2( 0.185, -0.893), vec2( 0.507,  0.064),
+    vec2( 0.896,  0.412), vec2(-0.322, -0.933), vec2(-0.792, -0.598)
+);
+
+// per pixel pseudo random value in [0, 1), stable from frame to frame
+float InterleavedGradientNoise(vec2 pixel)
+{
+    return fract(52.9829189 * fract(dot(pixel, vec2(0.06711056, 0.00583715))));
+}
+#endif
+
+// fraction of the light that reaches the fragment, texture() on a shadow sampler
+// compares against the reference depth and filters the 2x2 results bilinearly
+float SampleShadow(vec3 projCoords, float layer, float referenceDepth)
+{
+#if SHADOW_FILTER == 0
+    return texture(shadowMap, vec4(projCoords.xy, layer, referenceDepth));
+#else
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+    float lit = 0.0;
+#if SHADOW_FILTER == 1
+    for (int x = -1; x <= 1; x++)
+        for (int y = -1; y <= 1; y++)
+            lit += texture(shadowMap, vec4(projCoords.xy + vec2(x, y) * texelSize, layer, referenceDepth));
+    return lit / 9.0;
+#else
+    float angle = 6.2831853 * InterleavedGradientNoise(gl_FragCoord.xy);
+    mat2 rotation = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+    for (int i = 0; i < 12; i++)
+        lit += texture(shadowMap, vec4(projCoords.xy + rotation * poissonDisk[i] * 2.0 * texelSize, layer, referenceDepth));
+    return lit / 12.0;
+#endif
+#endif
+}
+
+float ShadowCalculation(vec3 fragPos, vec3 normal, vec3 lightDir)
 {
+    // the first cascade whose range still contains the fragment
+    float viewDepth = -(view * vec4(fragPos, 1.0)).z;
+    int cascade = cascadeCount - 1;
+    for (int i = 0; i < cascadeCount; i++)
+    {
+        if (viewDepth < cascadeSplits[i])
+        {
+            cascade = i;
+            break;
+        }
+    }
+
+    vec4 pos = lightSpaceMatrices[cascade] * vec4(fragPos, 1.0);
     vec3 projCoords = pos.xyz / pos.w;
-    projCoords = projCoords * 0.5 + 0.5;
-    float closestDepth = texture(shadowMap, projCoords.xy).r; 
-    float currentDepth = projCoords.z;
-    float shadow = currentDepth > closestDepth  ? 1.0 : 0.0;
+    projCoords = vec3(projCoords.xy * 0.5 + 0.5, NdcToDepth(projCoords.z));
+    if (IsBeyondFarPlane(projCoords.z))
+        return 0.0;
 
-    return shadow;
+    // far cascades cover more world per texel and need a larger bias
+    float bias = max(0.002 * (1.0 - dot(normal, lightDir)), 0.0005) * (cascade + 1);
+    return 1.0 - SampleShadow(projCoords, float(cascade), DepthTowardsViewer(projCoords.z, bias));
 }
 
 void main()
@@ -41,7 +115,11 @@ void main()
     float spec = pow(max(dot(normal, halfwayDir), 0.0), 64.0);
     vec3 specular = spec * lightColor;
 
-    float shadow = ShadowCalculation(fs_in.FragPosLightSpace);       
+#if SHADOWS
+    float shadow = ShadowCalculation(fs_in.FragPos, normal, lightDir);
+#else
+    float shadow = 0.0;
+#endif
     vec3 lighting = (ambient + (1.0 - shadow) * (diffuse + specular)) * color;    
 
     FragColor = vec4(lighting, 1.0f);
@@ -8,10 +8,7 @@ uniform sampler2D screenTexture;
 float _MinThreshold = 0.0312;
 float _Threshold = 0.125;
 
-float GetLuma(vec3 color)
-{
-    return color.x * 0.213 + color.y * 0.715 + color.z * 0.072;
-};
+#include "luma.glsl"
 
 void main()
 { 
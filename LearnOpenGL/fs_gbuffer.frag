@@ -0,0 +1,18 @@
+#version 330 core
+layout (location = 0) out vec4 gAlbedoSpecular;
+layout (location = 1) out vec4 gNormalRoughness;
+
+#include "gbuffer.glsl"
+#include "normalmap.glsl"
+
+in vec2 TexCoords;
+in vec3 Normal;
+
+uniform sampler2D texture_diffuse1;
+
+void main()
+{
+	// same material constants as the forward path in fs_clustered.frag
+	gAlbedoSpecular = vec4(vec3(texture(texture_diffuse1, TexCoords)), 0.2);
+	gNormalRoughness = vec4(OctEncode(SurfaceNormal(Normal, TexCoords)), RoughnessFromShininess(32.0), 0.0);
+}
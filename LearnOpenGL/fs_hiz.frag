@@ -0,0 +1,38 @@
+#version 330 core
+layout (location = 0) out vec2 MinMaxDepth;
+
+// permutation switch, FROM_DEPTH=1 copies the depth buffer into level 0 of the pyramid,
+// otherwise one level is reduced from the level below it
+#ifndef FROM_DEPTH
+#define FROM_DEPTH 0
+#endif
+
+#if FROM_DEPTH
+uniform sampler2D depthTexture;
+#else
+uniform sampler2D hizSource;    // RG32F min / max, its base level is the level below the target
+#endif
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+#if FROM_DEPTH
+    MinMaxDepth = vec2(texelFetch(depthTexture, pixel, 0).r);
+#else
+    ivec2 sourceSize = textureSize(hizSource, 0);
+    ivec2 base = pixel * 2;
+    // halving an odd size drops a row or column, the last target texel takes it
+    int columns = ((sourceSize.x & 1) != 0 && pixel.x == sourceSize.x / 2 - 1) ? 3 : 2;
+    int rows = ((sourceSize.y & 1) != 0 && pixel.y == sourceSize.y / 2 - 1) ? 3 : 2;
+    vec2 result = vec2(1.0e30, -1.0e30);
+    for (int y = 0; y < rows; y++)
+    {
+        for (int x = 0; x < columns; x++)
+        {
+            vec2 s = texelFetch(hizSource, min(base + ivec2(x, y), sourceSize - 1), 0).rg;
+            result = vec2(min(result.x, s.x), max(result.y, s.y));
+        }
+    }
+    MinMaxDepth = result;
+#endif
+}
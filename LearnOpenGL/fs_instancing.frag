@@ -6,7 +6,12 @@ in vec3 Normal;
 
 uniform sampler2D texture_diffuse1;
 
+// a fixed sun, ambient plus diffuse
+const vec3 lightDirection = vec3(-0.2, -1.0, -0.3);
+
 void main()
 {
-    FragColor = texture(texture_diffuse1, TexCoords);
-}
\ No newline at end of file
+    vec4 color = texture(texture_diffuse1, TexCoords);
+    float diffuse = max(dot(normalize(Normal), normalize(-lightDirection)), 0.0);
+    FragColor = vec4(color.rgb * (0.3 + 0.7 * diffuse), color.a);
+}
@@ -1,30 +1,16 @@
 #version 330 core
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec2 Velocity;
 
 in vec2 TexCoords;
+in vec4 CurrentPosition;
+in vec4 PreviousPosition;
 
-uniform sampler2D screenTexture;
 uniform sampler2D windowTexture;
-uniform bool useTexture;
-uniform bool firstDraw;
 
 void main()
 {
-	if (useTexture)
-	{
-		if (firstDraw)
-		{
-			FragColor = texture(windowTexture, TexCoords);
-		}
-		else
-		{
-			vec4 historyColor = texture(screenTexture, TexCoords);
-			vec4 currentColor = texture(windowTexture, TexCoords);
-			FragColor = historyColor * 0.95 + currentColor * 0.05;
-		}
-	}
-	else
-	{
-		FragColor = texture(windowTexture, TexCoords);
-	}
-}
\ No newline at end of file
+	FragColor = texture(windowTexture, TexCoords);
+	// screen-space motion since the last frame, in texture coordinates
+	Velocity = (CurrentPosition.xy / CurrentPosition.w - PreviousPosition.xy / PreviousPosition.w) * 0.5;
+}
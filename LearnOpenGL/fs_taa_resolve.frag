@@ -0,0 +1,74 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D currentTexture;
+uniform sampler2D historyTexture;
+uniform sampler2D velocityTexture;
+uniform sampler2D depthTexture;
+uniform bool historyValid;
+uniform float blendFactor;
+
+vec3 RGBToYCoCg(vec3 color)
+{
+    return vec3(
+         0.25 * color.r + 0.5 * color.g + 0.25 * color.b,
+         0.5  * color.r                 - 0.5  * color.b,
+        -0.25 * color.r + 0.5 * color.g - 0.25 * color.b);
+}
+
+vec3 YCoCgToRGB(vec3 color)
+{
+    return vec3(
+        color.x + color.y - color.z,
+        color.x           + color.z,
+        color.x - color.y - color.z);
+}
+
+void main()
+{
+    vec2 texelSize = 1.0 / vec2(textureSize(currentTexture, 0));
+    vec3 current = texture(currentTexture, TexCoords).rgb;
+    if (!historyValid)
+    {
+        FragColor = vec4(current, 1.0);
+        return;
+    }
+
+    // 3x3 neighbourhood: colour bounds in YCoCg, and the motion of the closest
+    // surface so edges move with the foreground
+    vec3 currentYCoCg = RGBToYCoCg(current);
+    vec3 minimum = currentYCoCg;
+    vec3 maximum = currentYCoCg;
+    float closestDepth = 1.0;
+    vec2 closestOffset = vec2(0.0);
+    for (int y = -1; y <= 1; y++)
+    {
+        for (int x = -1; x <= 1; x++)
+        {
+            vec2 offset = vec2(x, y) * texelSize;
+            vec3 neighbour = RGBToYCoCg(texture(currentTexture, TexCoords + offset).rgb);
+            minimum = min(minimum, neighbour);
+            maximum = max(maximum, neighbour);
+            float depth = texture(depthTexture, TexCoords + offset).r;
+            if (depth < closestDepth)
+            {
+                closestDepth = depth;
+                closestOffset = offset;
+            }
+        }
+    }
+
+    vec2 previousCoords = TexCoords - texture(velocityTexture, TexCoords + closestOffset).xy;
+    if (any(lessThan(previousCoords, vec2(0.0))) || any(greaterThan(previousCoords, vec2(1.0))))
+    {
+        FragColor = vec4(current, 1.0);
+        return;
+    }
+
+    // history outside the neighbourhood's colours is stale (disocclusion, lighting change)
+    vec3 history = RGBToYCoCg(texture(historyTexture, previousCoords).rgb);
+    history = clamp(history, minimum, maximum);
+    FragColor = vec4(mix(YCoCgToRGB(history), current, blendFactor), 1.0);
+}
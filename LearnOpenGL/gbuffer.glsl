@@ -0,0 +1,43 @@
+// G-buffer packing shared by fs_gbuffer.frag and fs_deferred.frag, see gbuffer.h
+
+vec2 OctWrap(vec2 v)
+{
+	return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// unit vector -> [0, 1]^2 by projecting onto an octahedron and folding the lower half
+vec2 OctEncode(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 encoded = n.z >= 0.0 ? n.xy : OctWrap(n.xy);
+	return encoded * 0.5 + 0.5;
+}
+
+vec3 OctDecode(vec2 encoded)
+{
+	encoded = encoded * 2.0 - 1.0;
+	vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+// Blinn-Phong exponent <-> roughness, the G-buffer stores the bounded roughness
+float RoughnessFromShininess(float shininess)
+{
+	return sqrt(2.0 / (shininess + 2.0));
+}
+
+float ShininessFromRoughness(float roughness)
+{
+	return 2.0 / max(roughness * roughness, 1e-4) - 2.0;
+}
+
+// view space position from a depth texture value and the screen uv
+vec3 ReconstructViewPosition(vec2 uv, float depth, mat4 inverseProjection)
+{
+	vec4 clip = vec4(uv * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+	vec4 viewPosition = inverseProjection * clip;
+	return viewPosition.xyz / viewPosition.w;
+}
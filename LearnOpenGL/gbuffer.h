@@ -0,0 +1,96 @@
+#pragma once
+#include <glad/glad.h>
+#include <iostream>
+
+#include "shader.h"
+#include "gpumemory.h"
+
+// Render targets of the deferred path, 8 bytes of color per pixel plus depth:
+//   gAlbedoSpecular   RGBA8     albedo.rgb, specular intensity
+//   gNormalRoughness  RGB10_A2  octahedral normal in rg, roughness in b
+//   gDepth            DEPTH24_STENCIL8, the lighting pass rebuilds positions from it
+// Encoding and decoding helpers live in gbuffer.glsl.
+class GBuffer
+{
+public:
+    unsigned int FBO;
+    unsigned int AlbedoSpecular;
+    unsigned int NormalRoughness;
+    unsigned int Depth;
+
+    GBuffer() : FBO(0), AlbedoSpecular(0), NormalRoughness(0), Depth(0), width(0), height(0)
+    {
+    }
+
+    ~GBuffer()
+    {
+        release();
+    }
+
+    // (re)creates the attachments when the framebuffer size changes
+    void Resize(int w, int h)
+    {
+        if (w == width && h == height && FBO != 0)
+            return;
+        release();
+        width = w;
+        height = h;
+
+        GPU_MEMORY_OWNER("gbuffer");
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        AlbedoSpecular = createTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, AlbedoSpecular, 0);
+        NormalRoughness = createTexture(GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, NormalRoughness, 0);
+        Depth = createTexture(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, Depth, 0);
+
+        unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: GBuffer is not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // binds the three targets to texture units firstUnit..firstUnit+2 for the lighting pass
+    void BindTextures(Shader& shader, int firstUnit)
+    {
+        const char* samplers[3] = { "gAlbedoSpecular", "gNormalRoughness", "gDepth" };
+        const unsigned int textures[3] = { AlbedoSpecular, NormalRoughness, Depth };
+        for (int i = 0; i < 3; i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            shader.setInt(samplers[i], firstUnit + i);
+        }
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+private:
+    int width, height;
+
+    unsigned int createTexture(GLenum internalFormat, GLenum format, GLenum type)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+        // the lighting pass reads exactly one texel per pixel
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    void release()
+    {
+        if (FBO == 0)
+            return;
+        unsigned int textures[3] = { AlbedoSpecular, NormalRoughness, Depth };
+        glDeleteTextures(3, textures);
+        glDeleteFramebuffers(1, &FBO);
+        FBO = AlbedoSpecular = NormalRoughness = Depth = 0;
+    }
+};
@@ -0,0 +1,220 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <vector>
+#include <deque>
+#include <utility>
+
+// Deletes GL objects once the GPU is done with them. Delete() only queues the
+// name; EndFrame() closes the frame's batch with a fence and frees the batches
+// whose fence has signaled, so an object dropped while a frame that draws with
+// it is still in flight outlives that frame, and streaming content out never
+// stalls on the GPU. DemoRunner calls EndFrame every frame and Shutdown before
+// the context goes away; names dropped after Shutdown die with the context.
+class GLDeletionQueue
+{
+public:
+    enum Kind { BUFFER, VERTEX_ARRAY, TEXTURE, FRAMEBUFFER, RENDERBUFFER, PROGRAM, KIND_COUNT };
+
+    static GLuint Generate(Kind kind)
+    {
+        GLuint name = 0;
+        switch (kind)
+        {
+        case BUFFER: glGenBuffers(1, &name); break;
+        case VERTEX_ARRAY: glGenVertexArrays(1, &name); break;
+        case TEXTURE: glGenTextures(1, &name); break;
+        case FRAMEBUFFER: glGenFramebuffers(1, &name); break;
+        case RENDERBUFFER: glGenRenderbuffers(1, &name); break;
+        case PROGRAM: name = glCreateProgram(); break;
+        default: break;
+        }
+        return name;
+    }
+
+    static void Delete(Kind kind, GLuint name)
+    {
+        State& s = state();
+        if (name == 0 || s.shutDown)
+            return;
+        s.pending.names[kind].push_back(name);
+    }
+
+    static void EndFrame()
+    {
+        State& s = state();
+        if (s.shutDown)
+            return;
+        if (!s.pending.Empty())
+        {
+            s.pending.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            s.inFlight.push_back(std::move(s.pending));
+            s.pending = Batch();
+        }
+        // batches retire in submission order, stop at the first the GPU has not reached
+        while (!s.inFlight.empty())
+        {
+            GLenum status = glClientWaitSync(s.inFlight.front().fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                break;
+            deleteBatch(s.inFlight.front());
+            s.inFlight.pop_front();
+        }
+    }
+
+    // frees everything at once, call with the context still current
+    static void Shutdown()
+    {
+        State& s = state();
+        if (s.shutDown)
+            return;
+        glFinish();
+        for (Batch& batch : s.inFlight)
+            deleteBatch(batch);
+        s.inFlight.clear();
+        deleteBatch(s.pending);
+        s.pending = Batch();
+        s.shutDown = true;
+    }
+
+    // names queued or waiting on a fence
+    static size_t PendingCount()
+    {
+        State& s = state();
+        size_t count = s.pending.Count();
+        for (const Batch& batch : s.inFlight)
+            count += batch.Count();
+        return count;
+    }
+
+private:
+    struct Batch {
+        std::vector<GLuint> names[KIND_COUNT];
+        GLsync fence = 0;
+
+        bool Empty() const
+        {
+            return Count() == 0;
+        }
+
+        size_t Count() const
+        {
+            size_t count = 0;
+            for (int k = 0; k < KIND_COUNT; k++)
+                count += names[k].size();
+            return count;
+        }
+    };
+
+    struct State {
+        Batch pending;
+        std::deque<Batch> inFlight;
+        bool shutDown = false;
+    };
+
+    static State& state()
+    {
+        static State s;
+        return s;
+    }
+
+    static void deleteBatch(Batch& batch)
+    {
+        std::vector<GLuint>* names = batch.names;
+        if (!names[BUFFER].empty())
+            glDeleteBuffers((GLsizei)names[BUFFER].size(), names[BUFFER].data());
+        if (!names[VERTEX_ARRAY].empty())
+            glDeleteVertexArrays((GLsizei)names[VERTEX_ARRAY].size(), names[VERTEX_ARRAY].data());
+        if (!names[TEXTURE].empty())
+            glDeleteTextures((GLsizei)names[TEXTURE].size(), names[TEXTURE].data());
+        if (!names[FRAMEBUFFER].empty())
+            glDeleteFramebuffers((GLsizei)names[FRAMEBUFFER].size(), names[FRAMEBUFFER].data());
+        if (!names[RENDERBUFFER].empty())
+            glDeleteRenderbuffers((GLsizei)names[RENDERBUFFER].size(), names[RENDERBUFFER].data());
+        for (GLuint program : names[PROGRAM])
+            glDeleteProgram(program);
+        if (batch.fence != 0)
+            glDeleteSync(batch.fence);
+        batch.fence = 0;
+    }
+};
+
+// Move-only owner of one GL object name, handed to GLDeletionQueue when it is
+// dropped. Converts to the raw name so it passes straight to gl* calls.
+template <GLDeletionQueue::Kind KIND>
+class GLHandle
+{
+public:
+    GLHandle() : name(0)
+    {
+    }
+
+    // takes ownership of an existing name
+    explicit GLHandle(GLuint name) : name(name)
+    {
+    }
+
+    GLHandle(GLHandle&& other) noexcept : name(other.name)
+    {
+        other.name = 0;
+    }
+
+    GLHandle& operator=(GLHandle&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Reset(other.name);
+            other.name = 0;
+        }
+        return *this;
+    }
+
+    GLHandle(const GLHandle&) = delete;
+    GLHandle& operator=(const GLHandle&) = delete;
+
+    ~GLHandle()
+    {
+        Reset();
+    }
+
+    static GLHandle Create()
+    {
+        return GLHandle(GLDeletionQueue::Generate(KIND));
+    }
+
+    GLuint Get() const
+    {
+        return name;
+    }
+
+    operator GLuint() const
+    {
+        return name;
+    }
+
+    // gives up ownership without deleting
+    GLuint Release()
+    {
+        GLuint released = name;
+        name = 0;
+        return released;
+    }
+
+    // queues the current name for deletion and owns newName instead
+    void Reset(GLuint newName = 0)
+    {
+        if (name != 0 && name != newName)
+            GLDeletionQueue::Delete(KIND, name);
+        name = newName;
+    }
+
+private:
+    GLuint name;
+};
+
+typedef GLHandle<GLDeletionQueue::BUFFER> GLBuffer;
+typedef GLHandle<GLDeletionQueue::VERTEX_ARRAY> GLVertexArray;
+typedef GLHandle<GLDeletionQueue::TEXTURE> GLTexture;
+typedef GLHandle<GLDeletionQueue::FRAMEBUFFER> GLFramebuffer;
+typedef GLHandle<GLDeletionQueue::RENDERBUFFER> GLRenderbuffer;
+typedef GLHandle<GLDeletionQueue::PROGRAM> GLProgram;
@@ -0,0 +1,518 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <map>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+
+// Accounts the video memory of every buffer, texture and renderbuffer.
+// Install() wraps glad's allocation, binding and deletion entry points, so
+// sizes are recorded wherever the storage is created. Textures count all
+// their faces and, after glGenerateMipmap, the full mip chain; textures and
+// renderbuffers attached to a framebuffer count as render targets. Sizes are
+// the nominal texel sizes with 3-channel formats padded to 4 bytes, as drivers
+// store them; the driver's real footprint differs by alignment and compression.
+//
+// GPU_MEMORY_OWNER("mesh") labels the storage created in the rest of the
+// enclosing block with an owner and the file and line of the label.
+// DemoRunner installs the registry with LOGL_GPU_MEMORY, takes the budget in
+// MiB from LOGL_GPU_MEMORY_BUDGET_MB, prints Report() after the first frame
+// and on F12, and reports what is still allocated at exit as leaks.
+class GpuMemory
+{
+public:
+    enum Category { BUFFER, TEXTURE, CUBEMAP, RENDER_TARGET, CATEGORY_COUNT };
+
+    static void Install(unsigned long long budgetBytes)
+    {
+        State& s = state();
+        s.budget = budgetBytes;
+        if (s.installed)
+            return;
+        s.installed = true;
+#define GPU_MEMORY_HOOK(name) s.name = glad_gl##name; glad_gl##name = track##name
+        GPU_MEMORY_HOOK(BindBuffer);
+        GPU_MEMORY_HOOK(BufferData);
+        GPU_MEMORY_HOOK(DeleteBuffers);
+        GPU_MEMORY_HOOK(ActiveTexture);
+        GPU_MEMORY_HOOK(BindTexture);
+        GPU_MEMORY_HOOK(TexImage2D);
+        GPU_MEMORY_HOOK(TexImage3D);
+        GPU_MEMORY_HOOK(GenerateMipmap);
+        GPU_MEMORY_HOOK(DeleteTextures);
+        GPU_MEMORY_HOOK(BindRenderbuffer);
+        GPU_MEMORY_HOOK(RenderbufferStorage);
+        GPU_MEMORY_HOOK(RenderbufferStorageMultisample);
+        GPU_MEMORY_HOOK(DeleteRenderbuffers);
+        GPU_MEMORY_HOOK(FramebufferTexture2D);
+        GPU_MEMORY_HOOK(FramebufferTextureLayer);
+#undef GPU_MEMORY_HOOK
+    }
+
+    static bool Installed()
+    {
+        return state().installed;
+    }
+
+    static unsigned long long TotalBytes()
+    {
+        return state().total;
+    }
+
+    static unsigned long long CategoryBytes(Category category)
+    {
+        unsigned long long bytes = 0;
+        for (const Record* record : records())
+            if (record->Kind == category)
+                bytes += record->Bytes;
+        return bytes;
+    }
+
+    // totals by category, then the largest objects first
+    static std::string Report(size_t maxObjects = 25)
+    {
+        State& s = state();
+        std::vector<const Record*> sorted = records();
+        std::sort(sorted.begin(), sorted.end(), [](const Record* a, const Record* b) { return a->Bytes > b->Bytes; });
+
+        std::ostringstream report;
+        report << std::fixed << std::setprecision(2);
+        report << "GPU_MEMORY:: " << mib(s.total) << " MiB in " << sorted.size() << " objects";
+        if (s.budget > 0)
+            report << ", budget " << mib(s.budget) << " MiB";
+        report << "\n";
+        for (int c = 0; c < CATEGORY_COUNT; c++)
+            report << "GPU_MEMORY::   " << std::left << std::setw(14) << CATEGORY_NAMES[c] << std::right << std::setw(12) << size(CategoryBytes((Category)c)) << "\n";
+        for (size_t i = 0; i < sorted.size() && i < maxObjects; i++)
+        {
+            const Record& r = *sorted[i];
+            report << "GPU_MEMORY:: " << std::setw(12) << size(r.Bytes) << "  " << std::left << std::setw(14) << CATEGORY_NAMES[r.Kind]
+                << std::setw(34) << r.Format << std::setw(16) << r.Owner << std::right << r.Site << "\n";
+        }
+        return report.str();
+    }
+
+private:
+    struct Record {
+        Category Kind = BUFFER;
+        unsigned long long Bytes = 0;
+        std::string Format;
+        const char* Owner = "unlabeled";
+        std::string Site;
+        // textures: level 0 size per face, for the mip chain
+        GLenum Target = 0;
+        GLenum InternalFormat = 0;
+        int Width = 0, Height = 0, Depth = 1;
+        unsigned int FaceMask = 0;
+        bool Mipmapped = false;
+        // levels above 0 allocated one by one, by level and face
+        std::map<int, unsigned long long> Levels;
+    };
+
+    struct State {
+        bool installed = false;
+        unsigned long long budget = 0;
+        unsigned long long total = 0;
+        bool overBudget = false;
+        std::unordered_map<GLuint, Record> buffers, textures, renderbuffers;
+        std::unordered_map<GLenum, GLuint> boundBuffers;
+        std::unordered_map<unsigned long long, GLuint> boundTextures;
+        GLenum activeTexture = GL_TEXTURE0;
+        GLuint boundRenderbuffer = 0;
+        const char* owner = nullptr;
+        const char* ownerFile = nullptr;
+        int ownerLine = 0;
+
+        PFNGLBINDBUFFERPROC BindBuffer;
+        PFNGLBUFFERDATAPROC BufferData;
+        PFNGLDELETEBUFFERSPROC DeleteBuffers;
+        PFNGLACTIVETEXTUREPROC ActiveTexture;
+        PFNGLBINDTEXTUREPROC BindTexture;
+        PFNGLTEXIMAGE2DPROC TexImage2D;
+        PFNGLTEXIMAGE3DPROC TexImage3D;
+        PFNGLGENERATEMIPMAPPROC GenerateMipmap;
+        PFNGLDELETETEXTURESPROC DeleteTextures;
+        PFNGLBINDRENDERBUFFERPROC BindRenderbuffer;
+        PFNGLRENDERBUFFERSTORAGEPROC RenderbufferStorage;
+        PFNGLRENDERBUFFERSTORAGEMULTISAMPLEPROC RenderbufferStorageMultisample;
+        PFNGLDELETERENDERBUFFERSPROC DeleteRenderbuffers;
+        PFNGLFRAMEBUFFERTEXTURE2DPROC FramebufferTexture2D;
+        PFNGLFRAMEBUFFERTEXTURELAYERPROC FramebufferTextureLayer;
+    };
+
+    static constexpr const char* CATEGORY_NAMES[CATEGORY_COUNT] = { "buffer", "texture", "cubemap", "render target" };
+
+    static State& state()
+    {
+        static State s;
+        return s;
+    }
+
+    friend class GpuMemoryOwner;
+
+    static std::vector<const Record*> records()
+    {
+        State& s = state();
+        std::vector<const Record*> all;
+        for (auto& entry : s.buffers)
+            all.push_back(&entry.second);
+        for (auto& entry : s.textures)
+            all.push_back(&entry.second);
+        for (auto& entry : s.renderbuffers)
+            all.push_back(&entry.second);
+        return all;
+    }
+
+    static double mib(unsigned long long bytes)
+    {
+        return bytes / (1024.0 * 1024.0);
+    }
+
+    static std::string size(unsigned long long bytes)
+    {
+        std::ostringstream text;
+        text << std::fixed << std::setprecision(2);
+        if (bytes < 1024 * 1024)
+            text << bytes / 1024.0 << " KiB";
+        else
+            text << mib(bytes) << " MiB";
+        return text.str();
+    }
+
+    static void label(Record& record)
+    {
+        State& s = state();
+        if (s.owner == nullptr)
+            return;
+        record.Owner = s.owner;
+        std::string file = s.ownerFile;
+        size_t slash = file.find_last_of("/\\");
+        record.Site = (slash == std::string::npos ? file : file.substr(slash + 1)) + ":" + std::to_string(s.ownerLine);
+    }
+
+    // replaces the size of a record and checks the budget
+    static void resize(Record& record, unsigned long long bytes)
+    {
+        State& s = state();
+        s.total = s.total - record.Bytes + bytes;
+        record.Bytes = bytes;
+        if (s.budget > 0 && s.total > s.budget && !s.overBudget)
+            std::cout << "WARNING::GPU_MEMORY:: " << std::fixed << std::setprecision(2) << mib(s.total) << " MiB exceeds the budget of "
+                << mib(s.budget) << " MiB, the last allocation was " << record.Format << " (" << record.Owner << " " << record.Site << ")" << std::endl;
+        s.overBudget = s.budget > 0 && s.total > s.budget;
+    }
+
+    static void erase(std::unordered_map<GLuint, Record>& map, GLsizei n, const GLuint* names)
+    {
+        State& s = state();
+        for (GLsizei i = 0; i < n; i++)
+        {
+            auto it = map.find(names[i]);
+            if (it == map.end())
+                continue;
+            s.total -= it->second.Bytes;
+            map.erase(it);
+        }
+        s.overBudget = s.budget > 0 && s.total > s.budget;
+    }
+
+    static unsigned int texelBytes(GLenum internalFormat)
+    {
+        switch (internalFormat)
+        {
+        case GL_R8: case GL_RED: case GL_R8UI: case GL_R8I:
+            return 1;
+        case GL_RG8: case GL_RG: case GL_R16F: case GL_R16: case GL_R16UI: case GL_R16I: case GL_DEPTH_COMPONENT16:
+            return 2;
+        case GL_RGB16F: case GL_RGBA16F: case GL_RG32F: case GL_RG32UI: case GL_RGBA16: case GL_RGB16: case GL_DEPTH32F_STENCIL8:
+            return 8;
+        case GL_RGB32F: case GL_RGBA32F: case GL_RGBA32UI: case GL_RGB32UI:
+            return 16;
+        default:
+            // RGB(A)8, sRGB, packed 32-bit, R32F, RG16F, depth 24/32 and depth-stencil
+            return 4;
+        }
+    }
+
+    static const char* formatName(GLenum internalFormat)
+    {
+        switch (internalFormat)
+        {
+        case GL_RED: return "RED";
+        case GL_RG: return "RG";
+        case GL_RGB: return "RGB";
+        case GL_RGBA: return "RGBA";
+        case GL_R8: return "R8";
+        case GL_RG8: return "RG8";
+        case GL_RGB8: return "RGB8";
+        case GL_RGBA8: return "RGBA8";
+        case GL_SRGB8: return "SRGB8";
+        case GL_SRGB8_ALPHA8: return "SRGB8_A8";
+        case GL_R16F: return "R16F";
+        case GL_RG16F: return "RG16F";
+        case GL_RGB16F: return "RGB16F";
+        case GL_RGBA16F: return "RGBA16F";
+        case GL_R32F: return "R32F";
+        case GL_RG32F: return "RG32F";
+        case GL_RGB32F: return "RGB32F";
+        case GL_RGBA32F: return "RGBA32F";
+        case GL_RGB10_A2: return "RGB10_A2";
+        case GL_R11F_G11F_B10F: return "R11F_G11F_B10F";
+        case GL_R32UI: return "R32UI";
+        case GL_RG32UI: return "RG32UI";
+        case GL_DEPTH_COMPONENT: return "DEPTH";
+        case GL_DEPTH_COMPONENT16: return "DEPTH16";
+        case GL_DEPTH_COMPONENT24: return "DEPTH24";
+        case GL_DEPTH_COMPONENT32F: return "DEPTH32F";
+        case GL_DEPTH24_STENCIL8: return "DEPTH24_STENCIL8";
+        case GL_DEPTH32F_STENCIL8: return "DEPTH32F_STENCIL8";
+        default: return "format";
+        }
+    }
+
+    static bool isCubeFace(GLenum target)
+    {
+        return target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z;
+    }
+
+    static GLuint boundTexture(GLenum target)
+    {
+        State& s = state();
+        auto it = s.boundTextures.find(((unsigned long long)s.activeTexture << 32) | target);
+        return it == s.boundTextures.end() ? 0 : it->second;
+    }
+
+    // recomputes a texture's size from its level 0 faces and mip state
+    static void sizeTexture(Record& record)
+    {
+        unsigned long long bytes = 0;
+        int faces = 0;
+        for (unsigned int mask = record.FaceMask; mask; mask >>= 1)
+            faces += mask & 1;
+        int w = record.Width, h = record.Height, d = record.Depth;
+        bool layered = record.Target == GL_TEXTURE_2D_ARRAY;
+        while (true)
+        {
+            bytes += (unsigned long long)w * h * d * texelBytes(record.InternalFormat);
+            if (!record.Mipmapped || (w == 1 && h == 1 && (layered || d == 1)))
+                break;
+            w = std::max(w / 2, 1);
+            h = std::max(h / 2, 1);
+            if (!layered)
+                d = std::max(d / 2, 1);
+        }
+        bytes *= std::max(faces, 1);
+        if (!record.Mipmapped)
+            for (auto& level : record.Levels)
+                bytes += level.second;
+        std::ostringstream format;
+        format << formatName(record.InternalFormat) << " " << record.Width << "x" << record.Height;
+        if (record.Depth > 1)
+            format << "x" << record.Depth;
+        if (faces > 1)
+            format << " x" << faces << " faces";
+        if (record.Mipmapped || !record.Levels.empty())
+            format << " mips";
+        record.Format = format.str();
+        resize(record, bytes);
+    }
+
+    static void textureImage(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLsizei depth)
+    {
+        bool face = isCubeFace(target);
+        GLenum bindTarget = face ? GL_TEXTURE_CUBE_MAP : target;
+        GLuint texture = boundTexture(bindTarget);
+        if (texture == 0)
+            return;
+        Record& record = state().textures[texture];
+        if (record.Format.empty())
+            label(record);
+        if (face)
+            record.Kind = CUBEMAP;
+        else if (record.Kind != RENDER_TARGET)
+            record.Kind = TEXTURE;
+        if (level > 0)
+        {
+            int faceIndex = face ? target - GL_TEXTURE_CUBE_MAP_POSITIVE_X : 0;
+            record.Levels[level * 6 + faceIndex] = (unsigned long long)width * height * depth * texelBytes(internalFormat);
+            sizeTexture(record);
+            return;
+        }
+        record.Target = bindTarget;
+        record.InternalFormat = internalFormat;
+        record.Width = width;
+        record.Height = height;
+        record.Depth = depth;
+        record.FaceMask |= face ? 1u << (target - GL_TEXTURE_CUBE_MAP_POSITIVE_X) : 1u;
+        sizeTexture(record);
+    }
+
+    static void APIENTRY trackBindBuffer(GLenum target, GLuint buffer)
+    {
+        state().boundBuffers[target] = buffer;
+        state().BindBuffer(target, buffer);
+    }
+
+    static void APIENTRY trackBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+    {
+        State& s = state();
+        s.BufferData(target, size, data, usage);
+        GLuint buffer = s.boundBuffers[target];
+        if (buffer == 0)
+            return;
+        Record& record = s.buffers[buffer];
+        if (record.Format.empty())
+            label(record);
+        record.Kind = BUFFER;
+        record.Format = "buffer";
+        resize(record, size);
+    }
+
+    static void APIENTRY trackDeleteBuffers(GLsizei n, const GLuint* buffers)
+    {
+        erase(state().buffers, n, buffers);
+        state().DeleteBuffers(n, buffers);
+    }
+
+    static void APIENTRY trackActiveTexture(GLenum texture)
+    {
+        state().activeTexture = texture;
+        state().ActiveTexture(texture);
+    }
+
+    static void APIENTRY trackBindTexture(GLenum target, GLuint texture)
+    {
+        State& s = state();
+        s.boundTextures[((unsigned long long)s.activeTexture << 32) | target] = texture;
+        s.BindTexture(target, texture);
+    }
+
+    static void APIENTRY trackTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels)
+    {
+        state().TexImage2D(target, level, internalformat, width, height, border, format, type, pixels);
+        textureImage(target, level, internalformat, width, height, 1);
+    }
+
+    static void APIENTRY trackTexImage3D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void* pixels)
+    {
+        state().TexImage3D(target, level, internalformat, width, height, depth, border, format, type, pixels);
+        textureImage(target, level, internalformat, width, height, depth);
+    }
+
+    static void APIENTRY trackGenerateMipmap(GLenum target)
+    {
+        state().GenerateMipmap(target);
+        GLuint texture = boundTexture(target);
+        auto it = state().textures.find(texture);
+        if (it == state().textures.end() || it->second.Mipmapped)
+            return;
+        it->second.Mipmapped = true;
+        sizeTexture(it->second);
+    }
+
+    static void APIENTRY trackDeleteTextures(GLsizei n, const GLuint* textures)
+    {
+        erase(state().textures, n, textures);
+        state().DeleteTextures(n, textures);
+    }
+
+    static void APIENTRY trackBindRenderbuffer(GLenum target, GLuint renderbuffer)
+    {
+        state().boundRenderbuffer = renderbuffer;
+        state().BindRenderbuffer(target, renderbuffer);
+    }
+
+    static void renderbufferStorage(GLsizei samples, GLenum internalformat, GLsizei width, GLsizei height)
+    {
+        State& s = state();
+        if (s.boundRenderbuffer == 0)
+            return;
+        Record& record = s.renderbuffers[s.boundRenderbuffer];
+        if (record.Format.empty())
+            label(record);
+        record.Kind = RENDER_TARGET;
+        std::ostringstream format;
+        format << formatName(internalformat) << " " << width << "x" << height;
+        if (samples > 1)
+            format << " x" << samples << " samples";
+        record.Format = format.str();
+        resize(record, (unsigned long long)width * height * texelBytes(internalformat) * std::max(samples, 1));
+    }
+
+    static void APIENTRY trackRenderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height)
+    {
+        state().RenderbufferStorage(target, internalformat, width, height);
+        renderbufferStorage(1, internalformat, width, height);
+    }
+
+    static void APIENTRY trackRenderbufferStorageMultisample(GLenum target, GLsizei samples, GLenum internalformat, GLsizei width, GLsizei height)
+    {
+        state().RenderbufferStorageMultisample(target, samples, internalformat, width, height);
+        renderbufferStorage(samples, internalformat, width, height);
+    }
+
+    static void APIENTRY trackDeleteRenderbuffers(GLsizei n, const GLuint* renderbuffers)
+    {
+        erase(state().renderbuffers, n, renderbuffers);
+        state().DeleteRenderbuffers(n, renderbuffers);
+    }
+
+    static void attachTexture(GLuint texture)
+    {
+        auto it = state().textures.find(texture);
+        if (it != state().textures.end())
+            it->second.Kind = RENDER_TARGET;
+    }
+
+    static void APIENTRY trackFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level)
+    {
+        attachTexture(texture);
+        state().FramebufferTexture2D(target, attachment, textarget, texture, level);
+    }
+
+    static void APIENTRY trackFramebufferTextureLayer(GLenum target, GLenum attachment, GLuint texture, GLint level, GLint layer)
+    {
+        attachTexture(texture);
+        state().FramebufferTextureLayer(target, attachment, texture, level, layer);
+    }
+};
+
+constexpr const char* GpuMemory::CATEGORY_NAMES[GpuMemory::CATEGORY_COUNT];
+
+// labels the GPU storage created while it is alive, see GpuMemory
+class GpuMemoryOwner
+{
+public:
+    GpuMemoryOwner(const char* owner, const char* file, int line)
+    {
+        GpuMemory::State& s = GpuMemory::state();
+        previousOwner = s.owner;
+        previousFile = s.ownerFile;
+        previousLine = s.ownerLine;
+        s.owner = owner;
+        s.ownerFile = file;
+        s.ownerLine = line;
+    }
+
+    ~GpuMemoryOwner()
+    {
+        GpuMemory::State& s = GpuMemory::state();
+        s.owner = previousOwner;
+        s.ownerFile = previousFile;
+        s.ownerLine = previousLine;
+    }
+
+private:
+    const char* previousOwner;
+    const char* previousFile;
+    int previousLine;
+};
+
+#define GPU_MEMORY_OWNER_CONCAT_(a, b) a##b
+#define GPU_MEMORY_OWNER_CONCAT(a, b) GPU_MEMORY_OWNER_CONCAT_(a, b)
+#define GPU_MEMORY_OWNER(owner) GpuMemoryOwner GPU_MEMORY_OWNER_CONCAT(gpuMemoryOwner, __LINE__)(owner, __FILE__, __LINE__)
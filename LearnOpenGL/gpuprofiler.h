@@ -0,0 +1,299 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+
+// Per-pass frame profiler. PROFILE_GPU("shadow") times the rest of the
+// enclosing block on the GPU, with a GL_TIMESTAMP query at each end, and on
+// the CPU. Unlike GL_TIME_ELAPSED (GpuTimer) timestamps let scopes nest.
+// Every frame's queries are read FRAME_LATENCY frames later, and only if they
+// are available by then, so profiling never waits for the GPU: a late frame is
+// dropped from the statistics instead. PROFILE_CPU("occlusion") times CPU-only
+// work the same way without queries, so its gpu column stays empty.
+// DemoRunner calls BeginFrame and EndFrame, which open and close a "frame"
+// scope, and enables the profiler with LOGL_PROFILE. LOGL_PROFILE_TRACE=<file>
+// also records every scope to a Chrome trace (chrome://tracing, Perfetto).
+class GpuProfiler
+{
+public:
+    static GpuProfiler& Get()
+    {
+        static GpuProfiler profiler;
+        return profiler;
+    }
+
+    // call with a current context. tracePath may be null
+    void Enable(const char* tracePath)
+    {
+        enabled = true;
+        if (tracePath != nullptr)
+            this->tracePath = tracePath;
+        cpuBase = std::chrono::steady_clock::now();
+        glGetInteger64v(GL_TIMESTAMP, &gpuBase);
+    }
+
+    bool Enabled() const
+    {
+        return enabled;
+    }
+
+    void BeginFrame()
+    {
+        if (!enabled)
+            return;
+        Frame& frame = frames[frameIndex % FRAME_LATENCY];
+        if (frameIndex >= FRAME_LATENCY)
+            collect(frame);
+        frame.Scopes.clear();
+        frame.UsedQueries = 0;
+        depth = 0;
+        frameScope = BeginScope("frame");
+    }
+
+    void EndFrame()
+    {
+        if (!enabled)
+            return;
+        EndScope(frameScope);
+        frameIndex++;
+    }
+
+    // gpu false records CPU time only
+    int BeginScope(const char* name, bool gpu = true)
+    {
+        if (!enabled)
+            return -1;
+        Frame& frame = frames[frameIndex % FRAME_LATENCY];
+        Scope scope;
+        scope.Name = name;
+        scope.Depth = depth++;
+        scope.Gpu = gpu;
+        scope.CpuBegin = cpuMicroseconds();
+        scope.BeginQuery = scope.EndQuery = 0;
+        if (gpu)
+        {
+            scope.BeginQuery = nextQuery(frame);
+            glQueryCounter(scope.BeginQuery, GL_TIMESTAMP);
+        }
+        frame.Scopes.push_back(scope);
+        return (int)frame.Scopes.size() - 1;
+    }
+
+    void EndScope(int index)
+    {
+        if (!enabled || index < 0)
+            return;
+        Frame& frame = frames[frameIndex % FRAME_LATENCY];
+        Scope& scope = frame.Scopes[index];
+        if (scope.Gpu)
+        {
+            scope.EndQuery = nextQuery(frame);
+            glQueryCounter(scope.EndQuery, GL_TIMESTAMP);
+        }
+        scope.CpuEnd = cpuMicroseconds();
+        depth--;
+    }
+
+    // average GPU and CPU milliseconds per pass since the last call, then starts a new average
+    std::string TakeTable()
+    {
+        std::ostringstream table;
+        table << std::fixed << std::setprecision(3);
+        table << "PROFILE:: " << std::left << std::setw(24) << "pass" << std::right << std::setw(10) << "gpu ms" << std::setw(10) << "cpu ms"
+            << "   (" << sampledFrames << " frames, " << droppedFrames << " dropped)\n";
+        for (PassStats& pass : passes)
+        {
+            std::string label = std::string(pass.Depth * 2, ' ') + pass.Name;
+            double frames = std::max(sampledFrames, 1u);
+            table << "PROFILE:: " << std::left << std::setw(24) << label << std::right << std::setw(10);
+            if (pass.Gpu)
+                table << pass.GpuMs / frames;
+            else
+                table << "-";
+            table << std::setw(10) << pass.CpuMs / frames << "\n";
+            pass.GpuMs = pass.CpuMs = 0.0;
+        }
+        sampledFrames = droppedFrames = 0;
+        return table.str();
+    }
+
+    // writes the trace, call before the context goes away
+    void Shutdown()
+    {
+        if (!enabled)
+            return;
+        if (!tracePath.empty())
+            writeTrace();
+        for (Frame& frame : frames)
+        {
+            if (!frame.Queries.empty())
+                glDeleteQueries((GLsizei)frame.Queries.size(), frame.Queries.data());
+            frame.Queries.clear();
+        }
+        enabled = false;
+    }
+
+private:
+    static const int FRAME_LATENCY = 3;
+    // a minute of a dozen scopes at 60 fps
+    static const size_t MAX_TRACE_EVENTS = 50000;
+
+    struct Scope {
+        const char* Name;
+        int Depth;
+        bool Gpu;
+        double CpuBegin, CpuEnd;
+        GLuint BeginQuery, EndQuery;
+    };
+
+    struct Frame {
+        std::vector<Scope> Scopes;
+        std::vector<GLuint> Queries;
+        size_t UsedQueries = 0;
+    };
+
+    struct PassStats {
+        std::string Name;
+        int Depth;
+        bool Gpu;
+        double GpuMs = 0.0, CpuMs = 0.0;
+    };
+
+    struct TraceEvent {
+        const char* Name;
+        bool Gpu;
+        double Begin, Duration;
+    };
+
+    bool enabled = false;
+    std::string tracePath;
+    Frame frames[FRAME_LATENCY];
+    unsigned int frameIndex = 0;
+    int depth = 0;
+    int frameScope = -1;
+
+    std::vector<PassStats> passes;
+    unsigned int sampledFrames = 0, droppedFrames = 0;
+    std::vector<TraceEvent> trace;
+    std::chrono::steady_clock::time_point cpuBase;
+    GLint64 gpuBase = 0;
+
+    double cpuMicroseconds() const
+    {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - cpuBase).count();
+    }
+
+    GLuint nextQuery(Frame& frame)
+    {
+        if (frame.UsedQueries == frame.Queries.size())
+        {
+            GLuint query;
+            glGenQueries(1, &query);
+            frame.Queries.push_back(query);
+        }
+        return frame.Queries[frame.UsedQueries++];
+    }
+
+    // reads the frame issued FRAME_LATENCY frames ago, if the GPU is done with it
+    void collect(const Frame& frame)
+    {
+        if (frame.Scopes.empty())
+            return;
+        GLint available = 0;
+        glGetQueryObjectiv(frame.Queries[frame.UsedQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+        {
+            droppedFrames++;
+            return;
+        }
+
+        for (const Scope& scope : frame.Scopes)
+        {
+            GLuint64 begin = 0, end = 0;
+            if (scope.Gpu)
+            {
+                glGetQueryObjectui64v(scope.BeginQuery, GL_QUERY_RESULT, &begin);
+                glGetQueryObjectui64v(scope.EndQuery, GL_QUERY_RESULT, &end);
+            }
+            double gpuMs = (double)(end - begin) / 1000000.0;
+            double cpuMs = (scope.CpuEnd - scope.CpuBegin) / 1000.0;
+
+            PassStats& pass = statsFor(scope);
+            pass.GpuMs += gpuMs;
+            pass.CpuMs += cpuMs;
+
+            if (!tracePath.empty() && trace.size() + 2 <= MAX_TRACE_EVENTS)
+            {
+                trace.push_back({ scope.Name, false, scope.CpuBegin, scope.CpuEnd - scope.CpuBegin });
+                if (scope.Gpu)
+                    trace.push_back({ scope.Name, true, (double)((GLint64)begin - gpuBase) / 1000.0, gpuMs * 1000.0 });
+            }
+        }
+        sampledFrames++;
+    }
+
+    // passes are told apart by name and nesting depth, listed in first-seen order
+    PassStats& statsFor(const Scope& scope)
+    {
+        for (PassStats& pass : passes)
+            if (pass.Depth == scope.Depth && pass.Name == scope.Name)
+                return pass;
+        PassStats pass;
+        pass.Name = scope.Name;
+        pass.Depth = scope.Depth;
+        pass.Gpu = scope.Gpu;
+        passes.push_back(pass);
+        return passes.back();
+    }
+
+    // Chrome trace event format, complete ("X") events in microseconds; CPU on thread 1, GPU on thread 2
+    void writeTrace() const
+    {
+        std::ofstream file(tracePath.c_str());
+        if (!file)
+        {
+            std::cout << "ERROR::PROFILE:: could not write " << tracePath << std::endl;
+            return;
+        }
+        file << std::fixed << std::setprecision(3);
+        file << "{\"traceEvents\":[\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+        for (const TraceEvent& event : trace)
+        {
+            file << ",\n{\"name\":\"" << event.Name << "\",\"cat\":\"" << (event.Gpu ? "gpu" : "cpu") << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                << (event.Gpu ? 2 : 1) << ",\"ts\":" << event.Begin << ",\"dur\":" << event.Duration << "}";
+        }
+        file << "\n]}\n";
+        std::cout << "PROFILE:: wrote " << trace.size() << " trace events to " << tracePath << std::endl;
+    }
+};
+
+// times the rest of the enclosing block, see GpuProfiler
+class GpuProfileScope
+{
+public:
+    explicit GpuProfileScope(const char* name, bool gpu = true) : index(GpuProfiler::Get().BeginScope(name, gpu))
+    {
+    }
+
+    ~GpuProfileScope()
+    {
+        GpuProfiler::Get().EndScope(index);
+    }
+
+private:
+    int index;
+};
+
+#define PROFILE_GPU_CONCAT_(a, b) a##b
+#define PROFILE_GPU_CONCAT(a, b) PROFILE_GPU_CONCAT_(a, b)
+#define PROFILE_GPU(name) GpuProfileScope PROFILE_GPU_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_CPU(name) GpuProfileScope PROFILE_GPU_CONCAT(profileScope, __LINE__)(name, false)
@@ -0,0 +1,89 @@
+#pragma once
+#include <glad/glad.h>
+
+// GPU duration of a range of GL commands, measured with GL_TIME_ELAPSED
+// queries. Results arrive a few frames late: they are read from a small ring of
+// queries once available, so measuring never makes the CPU wait for the GPU.
+// Time elapsed queries cannot nest, only one GpuTimer may be between Begin and End.
+class GpuTimer
+{
+public:
+    GpuTimer() : next(0), lastMs(0.0), totalMs(0.0), samples(0)
+    {
+        glGenQueries(QUERY_COUNT, queries);
+        for (int i = 0; i < QUERY_COUNT; i++)
+            inFlight[i] = false;
+    }
+
+    ~GpuTimer()
+    {
+        glDeleteQueries(QUERY_COUNT, queries);
+    }
+
+    void Begin()
+    {
+        collect();
+        // the ring is full, only happens when the GPU is several frames behind
+        if (inFlight[next])
+            readResult(next);
+        glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+    }
+
+    void End()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        inFlight[next] = true;
+        next = (next + 1) % QUERY_COUNT;
+    }
+
+    // most recent result in milliseconds
+    double LastMs() const
+    {
+        return lastMs;
+    }
+
+    // average over the results since the last call, then starts a new average
+    double TakeAverageMs()
+    {
+        double average = samples > 0 ? totalMs / samples : 0.0;
+        totalMs = 0.0;
+        samples = 0;
+        return average;
+    }
+
+private:
+    static const int QUERY_COUNT = 4;
+
+    unsigned int queries[QUERY_COUNT];
+    bool inFlight[QUERY_COUNT];
+    int next;
+    double lastMs;
+    double totalMs;
+    unsigned int samples;
+
+    // reads finished queries, oldest first
+    void collect()
+    {
+        for (int i = 0; i < QUERY_COUNT; i++)
+        {
+            int index = (next + i) % QUERY_COUNT;
+            if (!inFlight[index])
+                continue;
+            int available = 0;
+            glGetQueryObjectiv(queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            readResult(index);
+        }
+    }
+
+    void readResult(int index)
+    {
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &nanoseconds);
+        lastMs = nanoseconds / 1000000.0;
+        totalMs += lastMs;
+        samples++;
+        inFlight[index] = false;
+    }
+};
@@ -0,0 +1,297 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+#include "shader.h"
+#include "reversez.h"
+#include "gpumemory.h"
+
+// Hierarchical-Z occlusion culling. Build() reduces a frame's depth buffer
+// into a min / max mip pyramid (RG32F, one level per halving) and copies a
+// coarse level into a pixel buffer, Cull() tests world space boxes against
+// the newest copy that finished. Nothing waits for the GPU: the copy is one or
+// two frames old, so an object coming out from behind an occluder shows up
+// that much late. Boxes crossing the camera plane or the screen border of the
+// old view are always kept.
+class HiZCulling
+{
+public:
+    unsigned int PyramidTexture;
+
+    HiZCulling(int maxReadbackWidth = 128)
+        : PyramidTexture(0), maxReadbackWidth(maxReadbackWidth), width(0), height(0), levels(0), nextSlot(0), lastTested(0), lastCulled(0),
+          copyShader("vs_hiz.vert", "fs_hiz.frag", nullptr, ShaderDefines().Set("FROM_DEPTH", 1)),
+          reduceShader("vs_hiz.vert", "fs_hiz.frag", nullptr, ShaderDefines().Set("FROM_DEPTH", 0))
+    {
+        glGenFramebuffers(1, &FBO);
+        glGenVertexArrays(1, &emptyVAO);
+        for (int i = 0; i < READBACK_SLOTS; i++)
+        {
+            glGenBuffers(1, &slots[i].PBO);
+            slots[i].Fence = 0;
+        }
+        readback.Valid = false;
+    }
+
+    ~HiZCulling()
+    {
+        for (int i = 0; i < READBACK_SLOTS; i++)
+        {
+            if (slots[i].Fence != 0)
+                glDeleteSync(slots[i].Fence);
+            glDeleteBuffers(1, &slots[i].PBO);
+        }
+        glDeleteVertexArrays(1, &emptyVAO);
+        glDeleteFramebuffers(1, &FBO);
+        glDeleteTextures(1, &PyramidTexture);
+    }
+
+    // builds the pyramid from a depth texture that was rendered with viewProjection and queues
+    // its readback. Leaves framebuffer 0 bound and the viewport at the last level's size.
+    void Build(unsigned int depthTexture, int depthWidth, int depthHeight, const glm::mat4& viewProjection)
+    {
+        if (depthWidth != width || depthHeight != height)
+            resize(depthWidth, depthHeight);
+
+        GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+        glDisable(GL_DEPTH_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glBindVertexArray(emptyVAO);
+        glActiveTexture(GL_TEXTURE0);
+
+        copyShader.use();
+        copyShader.setInt("depthTexture", 0);
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        drawLevel(0);
+
+        // each level reads the one below, restricting the sampled levels avoids a feedback loop
+        reduceShader.use();
+        reduceShader.setInt("hizSource", 0);
+        glBindTexture(GL_TEXTURE_2D, PyramidTexture);
+        for (int level = 1; level < levels; level++)
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+            drawLevel(level);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+        queueReadback(viewProjection);
+
+        glBindVertexArray(0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (depthTest)
+            glEnable(GL_DEPTH_TEST);
+    }
+
+    // writes the indices of the instances whose box (localMin, localMax under the instance matrix)
+    // may be visible, also counts them for LastTested / LastCulled
+    void Cull(const glm::mat4* models, unsigned int count, const glm::vec3& localMin, const glm::vec3& localMax, std::vector<unsigned int>& visible)
+    {
+        collectReadback();
+        visible.clear();
+        for (unsigned int i = 0; i < count; i++)
+        {
+            if (!isOccluded(models[i], localMin, localMax))
+                visible.push_back(i);
+        }
+        lastTested = count;
+        lastCulled = count - (unsigned int)visible.size();
+    }
+
+    // boxes tested and rejected by the last Cull
+    unsigned int LastTested() const
+    {
+        return lastTested;
+    }
+
+    unsigned int LastCulled() const
+    {
+        return lastCulled;
+    }
+
+private:
+    static const int READBACK_SLOTS = 3;
+
+    struct Readback {
+        bool Valid;
+        int Level, Width, Height;       // pyramid level that was copied and its size
+        int FullWidth, FullHeight;      // size of level 0
+        bool Reversed, ZeroToOne;       // depth convention it was rendered with
+        glm::mat4 ViewProjection;
+        std::vector<float> MinMax;      // Width * Height RG pairs
+    };
+
+    struct Slot {
+        unsigned int PBO;
+        GLsync Fence;
+        Readback Info;
+    };
+
+    int maxReadbackWidth;
+    int width, height, levels;
+    unsigned int FBO;
+    unsigned int emptyVAO;
+    Slot slots[READBACK_SLOTS];
+    int nextSlot;
+    Readback readback;
+    unsigned int lastTested, lastCulled;
+    Shader copyShader;
+    Shader reduceShader;
+
+    static int levelSize(int size, int level)
+    {
+        return std::max(1, size >> level);
+    }
+
+    void resize(int w, int h)
+    {
+        width = w;
+        height = h;
+        levels = 1;
+        while ((w >> levels) > 0 || (h >> levels) > 0)
+            levels++;
+
+        GPU_MEMORY_OWNER("hi-z pyramid");
+        glDeleteTextures(1, &PyramidTexture);
+        glGenTextures(1, &PyramidTexture);
+        glBindTexture(GL_TEXTURE_2D, PyramidTexture);
+        for (int level = 0; level < levels; level++)
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RG32F, levelSize(w, level), levelSize(h, level), 0, GL_RG, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+        // readbacks of the old size no longer match
+        readback.Valid = false;
+    }
+
+    void drawLevel(int level)
+    {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, PyramidTexture, level);
+        if (level == 0 && glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: Hi-Z pyramid is not complete!" << std::endl;
+        glViewport(0, 0, levelSize(width, level), levelSize(height, level));
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+    void queueReadback(const glm::mat4& viewProjection)
+    {
+        Slot& slot = slots[nextSlot];
+        // still in flight: the GPU is frames behind, skip rather than wait
+        if (slot.Fence != 0)
+            return;
+
+        int level = 0;
+        while (level < levels - 1 && levelSize(width, level) > maxReadbackWidth)
+            level++;
+        Readback& info = slot.Info;
+        info.Level = level;
+        info.Width = levelSize(width, level);
+        info.Height = levelSize(height, level);
+        info.FullWidth = width;
+        info.FullHeight = height;
+        info.Reversed = ReverseZ::Enabled();
+        info.ZeroToOne = ReverseZ::ZeroToOne();
+        info.ViewProjection = viewProjection;
+
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, PyramidTexture, level);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        GPU_MEMORY_OWNER("hi-z readback");
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+        glBufferData(GL_PIXEL_PACK_BUFFER, info.Width * info.Height * 2 * sizeof(float), NULL, GL_STREAM_READ);
+        glReadPixels(0, 0, info.Width, info.Height, GL_RG, GL_FLOAT, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        nextSlot = (nextSlot + 1) % READBACK_SLOTS;
+    }
+
+    // takes the newest finished readback, oldest slots finish first
+    void collectReadback()
+    {
+        for (int i = 0; i < READBACK_SLOTS; i++)
+        {
+            Slot& slot = slots[(nextSlot + i) % READBACK_SLOTS];
+            if (slot.Fence == 0)
+                continue;
+            GLenum status = glClientWaitSync(slot.Fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                break;
+            glDeleteSync(slot.Fence);
+            slot.Fence = 0;
+            if (slot.Info.FullWidth != width || slot.Info.FullHeight != height)
+                continue;
+
+            readback = slot.Info;
+            readback.Valid = false;
+            readback.MinMax.resize(readback.Width * readback.Height * 2);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+            void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, readback.MinMax.size() * sizeof(float), GL_MAP_READ_BIT);
+            if (data != nullptr)
+            {
+                std::copy((const float*)data, (const float*)data + readback.MinMax.size(), readback.MinMax.begin());
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                readback.Valid = true;
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+    }
+
+    bool isOccluded(const glm::mat4& model, const glm::vec3& localMin, const glm::vec3& localMax) const
+    {
+        if (!readback.Valid)
+            return false;
+
+        // screen rectangle and nearest depth of the box in the old view
+        glm::mat4 transform = readback.ViewProjection * model;
+        glm::vec2 ndcMin(1e30f), ndcMax(-1e30f);
+        float nearest = readback.Reversed ? -1e30f : 1e30f;
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec4 corner((i & 1) ? localMax.x : localMin.x, (i & 2) ? localMax.y : localMin.y, (i & 4) ? localMax.z : localMin.z, 1.0f);
+            glm::vec4 clip = transform * corner;
+            if (clip.w <= 1e-5f)
+                return false;
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            ndcMin = glm::min(ndcMin, glm::vec2(ndc));
+            ndcMax = glm::max(ndcMax, glm::vec2(ndc));
+            float depth = readback.ZeroToOne ? ndc.z : ndc.z * 0.5f + 0.5f;
+            nearest = readback.Reversed ? std::max(nearest, depth) : std::min(nearest, depth);
+        }
+        if (ndcMin.x < -1.0f || ndcMin.y < -1.0f || ndcMax.x > 1.0f || ndcMax.y > 1.0f)
+            return false;
+
+        // level 0 pixels first, then down to the copied level, whose last row and column
+        // also cover what the halving of odd sizes dropped
+        int x0 = texelOf(ndcMin.x, readback.FullWidth, readback.Width);
+        int x1 = texelOf(ndcMax.x, readback.FullWidth, readback.Width);
+        int y0 = texelOf(ndcMin.y, readback.FullHeight, readback.Height);
+        int y1 = texelOf(ndcMax.y, readback.FullHeight, readback.Height);
+
+        // the farthest occluder depth over the rectangle: max for conventional depth, min when reversed
+        float farthest = readback.Reversed ? 1e30f : -1e30f;
+        for (int y = y0; y <= y1; y++)
+        {
+            for (int x = x0; x <= x1; x++)
+            {
+                const float* texel = &readback.MinMax[(y * readback.Width + x) * 2];
+                farthest = readback.Reversed ? std::min(farthest, texel[0]) : std::max(farthest, texel[1]);
+            }
+        }
+        return readback.Reversed ? nearest < farthest : nearest > farthest;
+    }
+
+    int texelOf(float ndc, int fullSize, int levelSize) const
+    {
+        int pixel = std::min(std::max((int)std::floor((ndc * 0.5f + 0.5f) * fullSize), 0), fullSize - 1);
+        return std::min(pixel >> readback.Level, levelSize - 1);
+    }
+};
@@ -0,0 +1,142 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#include "stb_image.h"
+#include "pngwriter.h"
+
+// RGBA8 pixels, top row first
+struct Image {
+    int Width = 0;
+    int Height = 0;
+    std::vector<unsigned char> Pixels;
+};
+
+// Compares a rendered frame against a reference image, for golden-image runs.
+// A frame passes when few pixels differ by more than a per-channel tolerance
+// (rasterization and driver noise) and the structural similarity (SSIM) of the
+// luma stays high, which catches shifted or blurred content a loose per-pixel
+// tolerance lets through.
+class ImageCompare
+{
+public:
+    struct Result {
+        bool SizeMatches = false;
+        int MaxDifference = 0;              // largest channel difference, 0-255
+        double OverToleranceFraction = 1.0; // share of pixels with a channel beyond the tolerance
+        double Ssim = 0.0;                  // mean SSIM of the luma, 1 is identical
+    };
+
+    static bool Load(const std::string& path, Image& image)
+    {
+        int width, height, channels;
+        unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 4);
+        if (!data)
+            return false;
+        image.Width = width;
+        image.Height = height;
+        image.Pixels.assign(data, data + (size_t)width * height * 4);
+        stbi_image_free(data);
+        return true;
+    }
+
+    static bool Save(const std::string& path, const Image& image)
+    {
+        return PngWriter::Write(path, image.Width, image.Height, 4, image.Pixels.data(), false);
+    }
+
+    // diff, when given, shows the amplified difference in gray and pixels beyond the tolerance in red
+    static Result Compare(const Image& image, const Image& reference, int tolerance, Image* diff = nullptr)
+    {
+        Result result;
+        if (image.Width != reference.Width || image.Height != reference.Height || image.Pixels.empty())
+            return result;
+        result.SizeMatches = true;
+
+        size_t pixelCount = (size_t)image.Width * image.Height;
+        size_t overTolerance = 0;
+        if (diff)
+        {
+            diff->Width = image.Width;
+            diff->Height = image.Height;
+            diff->Pixels.resize(pixelCount * 4);
+        }
+        for (size_t i = 0; i < pixelCount; i++)
+        {
+            int difference = 0;
+            for (int c = 0; c < 3; c++)
+                difference = std::max(difference, std::abs((int)image.Pixels[i * 4 + c] - (int)reference.Pixels[i * 4 + c]));
+            result.MaxDifference = std::max(result.MaxDifference, difference);
+            bool over = difference > tolerance;
+            if (over)
+                overTolerance++;
+            if (diff)
+            {
+                unsigned char gray = (unsigned char)std::min(difference * 4, 255);
+                unsigned char* out = &diff->Pixels[i * 4];
+                out[0] = over ? 255 : gray;
+                out[1] = over ? 0 : gray;
+                out[2] = over ? 0 : gray;
+                out[3] = 255;
+            }
+        }
+        result.OverToleranceFraction = (double)overTolerance / pixelCount;
+        result.Ssim = ssim(image, reference);
+        return result;
+    }
+
+private:
+    static const int SSIM_WINDOW = 8;
+    static const int SSIM_STRIDE = 4;
+
+    static std::vector<float> luma(const Image& image)
+    {
+        std::vector<float> y((size_t)image.Width * image.Height);
+        for (size_t i = 0; i < y.size(); i++)
+            y[i] = 0.299f * image.Pixels[i * 4] + 0.587f * image.Pixels[i * 4 + 1] + 0.114f * image.Pixels[i * 4 + 2];
+        return y;
+    }
+
+    // mean over 8x8 windows every 4 pixels, with the usual constants for 8-bit data
+    static double ssim(const Image& a, const Image& b)
+    {
+        const double c1 = (0.01 * 255.0) * (0.01 * 255.0);
+        const double c2 = (0.03 * 255.0) * (0.03 * 255.0);
+        std::vector<float> ya = luma(a), yb = luma(b);
+        int width = a.Width, height = a.Height;
+        if (width < SSIM_WINDOW || height < SSIM_WINDOW)
+            return ya == yb ? 1.0 : 0.0;
+
+        double total = 0.0;
+        int windows = 0;
+        const double n = SSIM_WINDOW * SSIM_WINDOW;
+        for (int wy = 0; wy + SSIM_WINDOW <= height; wy += SSIM_STRIDE)
+        {
+            for (int wx = 0; wx + SSIM_WINDOW <= width; wx += SSIM_STRIDE)
+            {
+                double sa = 0.0, sb = 0.0, saa = 0.0, sbb = 0.0, sab = 0.0;
+                for (int y = wy; y < wy + SSIM_WINDOW; y++)
+                {
+                    const float* ra = &ya[(size_t)y * width];
+                    const float* rb = &yb[(size_t)y * width];
+                    for (int x = wx; x < wx + SSIM_WINDOW; x++)
+                    {
+                        sa += ra[x];
+                        sb += rb[x];
+                        saa += ra[x] * ra[x];
+                        sbb += rb[x] * rb[x];
+                        sab += ra[x] * rb[x];
+                    }
+                }
+                double ma = sa / n, mb = sb / n;
+                double va = saa / n - ma * ma, vb = sbb / n - mb * mb, cov = sab / n - ma * mb;
+                total += ((2.0 * ma * mb + c1) * (2.0 * cov + c2)) / ((ma * ma + mb * mb + c1) * (va + vb + c2));
+                windows++;
+            }
+        }
+        return total / windows;
+    }
+};
@@ -0,0 +1,6 @@
+// Rec. 709 luma, shared by the post-process anti-aliasing shaders
+
+float GetLuma(vec3 color)
+{
+    return color.x * 0.213 + color.y * 0.715 + color.z * 0.072;
+}
@@ -0,0 +1,353 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LOGL_OCCLUSION_SSE 1
+#include <emmintrin.h>
+#endif
+
+// CPU occlusion culling in the style of masked software occlusion culling.
+// Occluder triangles are rasterized at low resolution into tiles of 8x4
+// pixels. A tile keeps no per-pixel depth, only a coverage mask with one bit
+// per pixel and two depths: the farthest depth known to cover the whole tile,
+// and the farthest depth of the working layer the mask belongs to. Once the
+// mask is full the working layer becomes the tile depth. A triangle much
+// nearer than the working layer replaces the layer instead of being merged
+// into it at the layer's depth. Depth is 1/w, which is linear across the
+// screen and independent of the projection's depth convention (larger is
+// nearer). Occludee boxes are then tested against the tile depths. No GL
+// involved: results only depend on the input, so the class can run headless.
+// Coverage samples pixel centers, like the GPU does. The SSE2 paths have
+// scalar equivalents for other targets.
+class MaskedOcclusionCulling
+{
+public:
+    static const int TILE_WIDTH = 8;
+    static const int TILE_HEIGHT = 4;
+
+    // width and height are rounded up to whole tiles
+    MaskedOcclusionCulling(int width = 256, int height = 128)
+        : zNear(0.1f), rasterMs(0.0), occluderTriangles(0), tested(0), culled(0)
+    {
+        tilesX = (width + TILE_WIDTH - 1) / TILE_WIDTH;
+        tilesY = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+        this->width = tilesX * TILE_WIDTH;
+        this->height = tilesY * TILE_HEIGHT;
+        // three more so the tests can always load four tiles
+        tileDepth.resize(tilesX * tilesY + 3);
+        layerDepth.resize(tilesX * tilesY);
+        layerMask.resize(tilesX * tilesY);
+        Clear(glm::mat4(1.0f), zNear);
+    }
+
+    // starts a frame: empties the buffer and the counters. zNear is the camera's near plane
+    // distance, occluder parts closer than it are clipped away like on the GPU
+    void Clear(const glm::mat4& viewProjection, float zNear)
+    {
+        this->viewProjection = viewProjection;
+        this->zNear = zNear;
+        std::fill(tileDepth.begin(), tileDepth.end(), 0.0f);
+        std::fill(layerDepth.begin(), layerDepth.end(), FLT_MAX);
+        std::fill(layerMask.begin(), layerMask.end(), 0u);
+        rasterMs = 0.0;
+        occluderTriangles = tested = culled = 0;
+    }
+
+    // rasterizes triangleCount triangles. positions points at the first vec3, consecutive
+    // vertices are strideBytes apart. Without indices the vertices form a triangle list.
+    void RenderOccluder(const glm::mat4& model, const void* positions, size_t strideBytes, const unsigned int* indices, size_t triangleCount)
+    {
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+        glm::mat4 transform = viewProjection * model;
+        const unsigned char* base = (const unsigned char*)positions;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            glm::vec4 clip[3];
+            for (int i = 0; i < 3; i++)
+            {
+                size_t index = indices != nullptr ? indices[t * 3 + i] : t * 3 + i;
+                const float* p = (const float*)(base + index * strideBytes);
+                clip[i] = transform * glm::vec4(p[0], p[1], p[2], 1.0f);
+            }
+            clipAndRasterize(clip);
+        }
+        occluderTriangles += (unsigned int)triangleCount;
+
+        rasterMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // false when the world space box is hidden behind the occluders or outside the view
+    bool IsVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+    {
+        tested++;
+        bool visible = testBox(boundsMin, boundsMax);
+        if (!visible)
+            culled++;
+        return visible;
+    }
+
+    // CPU time spent rasterizing occluders since Clear
+    double RasterMs() const
+    {
+        return rasterMs;
+    }
+
+    unsigned int OccluderTriangles() const
+    {
+        return occluderTriangles;
+    }
+
+    // boxes tested and rejected since Clear
+    unsigned int Tested() const
+    {
+        return tested;
+    }
+
+    unsigned int Culled() const
+    {
+        return culled;
+    }
+
+private:
+    struct ScreenVertex {
+        float X, Y;     // pixels
+        float Z;        // 1 / w
+    };
+
+    int width, height;
+    int tilesX, tilesY;
+    glm::mat4 viewProjection;
+    float zNear;
+    // per tile, row by row
+    std::vector<float> tileDepth;       // farthest 1/w that covers the whole tile
+    std::vector<float> layerDepth;      // farthest 1/w of the working layer, FLT_MAX when empty
+    std::vector<uint32_t> layerMask;    // pixels covered by the working layer, bit y * 8 + x
+    double rasterMs;
+    unsigned int occluderTriangles;
+    unsigned int tested, culled;
+
+    // clips against the near plane (w = zNear), which leaves a triangle or a quad
+    void clipAndRasterize(const glm::vec4* clip)
+    {
+        glm::vec4 polygon[4];
+        int count = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            const glm::vec4& a = clip[i];
+            const glm::vec4& b = clip[(i + 1) % 3];
+            bool aInside = a.w >= zNear, bInside = b.w >= zNear;
+            if (aInside)
+                polygon[count++] = a;
+            if (aInside != bInside)
+                polygon[count++] = a + (b - a) * ((zNear - a.w) / (b.w - a.w));
+        }
+        if (count < 3)
+            return;
+
+        ScreenVertex screen[4];
+        for (int i = 0; i < count; i++)
+        {
+            float inverseW = 1.0f / polygon[i].w;
+            screen[i].X = (polygon[i].x * inverseW * 0.5f + 0.5f) * width;
+            screen[i].Y = (polygon[i].y * inverseW * 0.5f + 0.5f) * height;
+            screen[i].Z = inverseW;
+        }
+        rasterizeTriangle(screen[0], screen[1], screen[2]);
+        if (count == 4)
+            rasterizeTriangle(screen[0], screen[2], screen[3]);
+    }
+
+    void rasterizeTriangle(ScreenVertex v0, ScreenVertex v1, ScreenVertex v2)
+    {
+        float area = (v1.X - v0.X) * (v2.Y - v0.Y) - (v2.X - v0.X) * (v1.Y - v0.Y);
+        if (std::fabs(area) < 1e-8f)
+            return;
+        // occluders are two sided, make the winding counter clockwise
+        if (area < 0.0f)
+        {
+            std::swap(v1, v2);
+            area = -area;
+        }
+
+        // pixel bounds, then tile bounds
+        float minX = std::min(v0.X, std::min(v1.X, v2.X)), maxX = std::max(v0.X, std::max(v1.X, v2.X));
+        float minY = std::min(v0.Y, std::min(v1.Y, v2.Y)), maxY = std::max(v0.Y, std::max(v1.Y, v2.Y));
+        if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height)
+            return;
+        int tileX0 = (int)std::max(minX, 0.0f) / TILE_WIDTH, tileX1 = (int)std::min(maxX, width - 1.0f) / TILE_WIDTH;
+        int tileY0 = (int)std::max(minY, 0.0f) / TILE_HEIGHT, tileY1 = (int)std::min(maxY, height - 1.0f) / TILE_HEIGHT;
+
+        // edge functions a * x + b * y + c, non-negative inside
+        const ScreenVertex* v[3] = { &v0, &v1, &v2 };
+        float edgeA[3], edgeB[3], edgeC[3];
+        for (int i = 0; i < 3; i++)
+        {
+            const ScreenVertex& a = *v[i];
+            const ScreenVertex& b = *v[(i + 1) % 3];
+            edgeA[i] = a.Y - b.Y;
+            edgeB[i] = b.X - a.X;
+            edgeC[i] = -(edgeA[i] * a.X + edgeB[i] * a.Y);
+        }
+
+        // 1/w plane, exact across the screen
+        float zdx = ((v1.Z - v0.Z) * (v2.Y - v0.Y) - (v2.Z - v0.Z) * (v1.Y - v0.Y)) / area;
+        float zdy = ((v1.X - v0.X) * (v2.Z - v0.Z) - (v2.X - v0.X) * (v1.Z - v0.Z)) / area;
+        float zMinVertex = std::min(v0.Z, std::min(v1.Z, v2.Z));
+        float zMaxVertex = std::max(v0.Z, std::max(v1.Z, v2.Z));
+
+#ifdef LOGL_OCCLUSION_SSE
+        // pixel center offsets inside a tile, per edge
+        __m128 columns0 = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        __m128 columns1 = _mm_setr_ps(4.5f, 5.5f, 6.5f, 7.5f);
+        __m128 edgeColumns0[3], edgeColumns1[3];
+        for (int i = 0; i < 3; i++)
+        {
+            __m128 a = _mm_set1_ps(edgeA[i]);
+            edgeColumns0[i] = _mm_mul_ps(a, columns0);
+            edgeColumns1[i] = _mm_mul_ps(a, columns1);
+        }
+        const __m128 zero = _mm_setzero_ps();
+#endif
+
+        for (int ty = tileY0; ty <= tileY1; ty++)
+        {
+            for (int tx = tileX0; tx <= tileX1; tx++)
+            {
+                float x = (float)(tx * TILE_WIDTH), y = (float)(ty * TILE_HEIGHT);
+                int tile = ty * tilesX + tx;
+
+                // 1/w range of the triangle over the tile: the plane at the tile corners, bounded by the vertices
+                float z00 = v0.Z + zdx * (x - v0.X) + zdy * (y - v0.Y);
+                float cornerDx = zdx * TILE_WIDTH, cornerDy = zdy * TILE_HEIGHT;
+                float cornerMin = z00 + std::min(cornerDx, 0.0f) + std::min(cornerDy, 0.0f);
+                float cornerMax = z00 + std::max(cornerDx, 0.0f) + std::max(cornerDy, 0.0f);
+                float triangleFar = std::max(cornerMin, zMinVertex);
+                float triangleNear = std::min(cornerMax, zMaxVertex);
+                // already hidden in this tile
+                if (triangleNear < tileDepth[tile])
+                    continue;
+
+                uint32_t coverage = 0;
+                for (int row = 0; row < TILE_HEIGHT; row++)
+                {
+#ifdef LOGL_OCCLUSION_SSE
+                    __m128 inside0 = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                    __m128 inside1 = inside0;
+                    for (int i = 0; i < 3; i++)
+                    {
+                        __m128 rowValue = _mm_set1_ps(edgeA[i] * x + edgeB[i] * (y + row + 0.5f) + edgeC[i]);
+                        inside0 = _mm_and_ps(inside0, _mm_cmpge_ps(_mm_add_ps(rowValue, edgeColumns0[i]), zero));
+                        inside1 = _mm_and_ps(inside1, _mm_cmpge_ps(_mm_add_ps(rowValue, edgeColumns1[i]), zero));
+                    }
+                    uint32_t bits = (uint32_t)_mm_movemask_ps(inside0) | ((uint32_t)_mm_movemask_ps(inside1) << 4);
+#else
+                    float rowValue[3];
+                    for (int i = 0; i < 3; i++)
+                        rowValue[i] = edgeA[i] * x + edgeB[i] * (y + row + 0.5f) + edgeC[i];
+                    uint32_t bits = 0;
+                    for (int column = 0; column < TILE_WIDTH; column++)
+                    {
+                        float offset = column + 0.5f;
+                        if (rowValue[0] + edgeA[0] * offset >= 0.0f && rowValue[1] + edgeA[1] * offset >= 0.0f && rowValue[2] + edgeA[2] * offset >= 0.0f)
+                            bits |= 1u << column;
+                    }
+#endif
+                    coverage |= bits << (row * TILE_WIDTH);
+                }
+                if (coverage == 0)
+                    continue;
+                updateTile(tile, coverage, triangleFar);
+            }
+        }
+    }
+
+    void updateTile(int tile, uint32_t coverage, float triangleFar)
+    {
+        // partly behind the tile depth: merging it could only pull the working layer behind the tile
+        if (triangleFar < tileDepth[tile])
+            return;
+
+        float& layer = layerDepth[tile];
+        uint32_t& mask = layerMask[tile];
+        // the working layer is dropped for a triangle that covers the whole tile, or that lies farther in
+        // front of it than the layer lies in front of the tile depth: merging would push the triangle back
+        // to the layer's depth and lose most of what it occludes
+        if (coverage == 0xFFFFFFFFu || (layer != FLT_MAX && triangleFar - layer > layer - tileDepth[tile]))
+        {
+            layer = triangleFar;
+            mask = coverage;
+        }
+        else
+        {
+            layer = std::min(layer, triangleFar);
+            mask |= coverage;
+        }
+        if (mask == 0xFFFFFFFFu)
+        {
+            tileDepth[tile] = std::max(tileDepth[tile], layer);
+            layer = FLT_MAX;
+            mask = 0;
+        }
+    }
+
+    bool testBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+    {
+        float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+        float nearest = 0.0f;
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec4 corner((i & 1) ? boundsMax.x : boundsMin.x, (i & 2) ? boundsMax.y : boundsMin.y, (i & 4) ? boundsMax.z : boundsMin.z, 1.0f);
+            glm::vec4 clip = viewProjection * corner;
+            // reaches past the near plane, the camera may be inside
+            if (clip.w < zNear)
+                return true;
+            float inverseW = 1.0f / clip.w;
+            float x = (clip.x * inverseW * 0.5f + 0.5f) * width;
+            float y = (clip.y * inverseW * 0.5f + 0.5f) * height;
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+            nearest = std::max(nearest, inverseW);
+        }
+        if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height)
+            return false;
+
+        int tileX0 = (int)std::max(minX, 0.0f) / TILE_WIDTH, tileX1 = (int)std::min(maxX, width - 1.0f) / TILE_WIDTH;
+        int tileY0 = (int)std::max(minY, 0.0f) / TILE_HEIGHT, tileY1 = (int)std::min(maxY, height - 1.0f) / TILE_HEIGHT;
+#ifdef LOGL_OCCLUSION_SSE
+        __m128 boxDepth = _mm_set1_ps(nearest);
+        for (int ty = tileY0; ty <= tileY1; ty++)
+        {
+            // four tiles per compare, lanes past tileX1 are masked off
+            for (int tx = tileX0; tx <= tileX1; tx += 4)
+            {
+                __m128 depth = _mm_loadu_ps(&tileDepth[ty * tilesX + tx]);
+                int lanes = std::min(tileX1 - tx + 1, 4);
+                int inFront = _mm_movemask_ps(_mm_cmpge_ps(boxDepth, depth)) & ((1 << lanes) - 1);
+                if (inFront != 0)
+                    return true;
+            }
+        }
+#else
+        for (int ty = tileY0; ty <= tileY1; ty++)
+        {
+            for (int tx = tileX0; tx <= tileX1; tx++)
+            {
+                if (nearest >= tileDepth[ty * tilesX + tx])
+                    return true;
+            }
+        }
+#endif
+        return false;
+    }
+};
@@ -1,16 +1,24 @@
 #pragma once
 #include "shader.h"
+#include "gpumemory.h"
+#include "glhandle.h"
 #include <vector>
 
 using namespace std;
 
 const string DIFFUSE_TYPE = "texture_diffuse";
 const string SPECULAR_TYPE = "texture_specular";
+const string NORMAL_TYPE = "texture_normal";
+
+// attribute locations 3-6 are taken by the per-instance model matrix
+const unsigned int TANGENT_LOCATION = 7;
 
 struct Vertex {
 	glm::vec3 Position;
 	glm::vec3 Normal;
 	glm::vec2 TexCoords;
+	// GL_INT_2_10_10_10_REV: xyz = tangent, w = bitangent sign
+	GLuint Tangent;
 };
 
 struct Texture {
@@ -19,26 +27,32 @@ struct Texture {
 	string path;
 };
 
+// owns its GL objects, so it can be moved but not copied
 class Mesh {
 public:
-	unsigned int VAO;
+	GLVertexArray VAO;
+	// position-only stream (attribute 0 only, 12 bytes per vertex) for depth-only passes, 0 when not kept
+	GLVertexArray DepthVAO;
 	vector<Vertex> vertices;
 	vector<unsigned int> indices;
 	vector<Texture> textures;
 
-	Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+	Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, bool positionStream = false)
 	{
-		this->vertices = vertices;
-		this->indices = indices;
-		this->textures = textures;
+		this->vertices = std::move(vertices);
+		this->indices = std::move(indices);
+		this->textures = std::move(textures);
 
 		Init();
+		if (positionStream)
+			InitPositionStream();
 	};
 
 	void Draw(Shader &shader) 
 	{
 		unsigned int diffuseIndex = 1;
 		unsigned int specularIndex = 1;
+		unsigned int normalIndex = 1;
 		
 		for (unsigned int i = 0; i < textures.size(); i++)
 		{
@@ -49,6 +63,8 @@ public:
 				index = to_string(diffuseIndex++);
 			else if (type == SPECULAR_TYPE)
 				index = to_string(specularIndex++);
+			else if (type == NORMAL_TYPE)
+				index = to_string(normalIndex++);
 
 			shader.setInt(type + index, i);
 			glBindTexture(GL_TEXTURE_2D, textures[i].id);
@@ -60,14 +76,26 @@ public:
 
 		glActiveTexture(GL_TEXTURE0);
 	};
+
+	// for shaders that only read the position (shadow maps, depth prepass), which the
+	// caller has in use: binds no textures and fetches from the position-only stream
+	// when the mesh keeps one
+	void DrawDepth()
+	{
+		glBindVertexArray(DepthVAO != 0 ? DepthVAO : VAO);
+		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+		glBindVertexArray(0);
+	};
 private:
-	unsigned int VBO, EBO;
+	GLBuffer VBO, EBO;
+	GLBuffer PositionVBO;
 
 	void Init()
 	{
-		glGenVertexArrays(1, &VAO);
-		glGenBuffers(1, &VBO);
-		glGenBuffers(1, &EBO);
+		GPU_MEMORY_OWNER("mesh");
+		VAO = GLVertexArray::Create();
+		VBO = GLBuffer::Create();
+		EBO = GLBuffer::Create();
 
 		glBindVertexArray(VAO);
 
@@ -83,6 +111,32 @@ private:
 		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
 		glEnableVertexAttribArray(2);
 		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+		glEnableVertexAttribArray(TANGENT_LOCATION);
+		glVertexAttribPointer(TANGENT_LOCATION, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+
+		glBindVertexArray(0);
+	};
+
+	void InitPositionStream()
+	{
+		vector<glm::vec3> positions(vertices.size());
+		for (unsigned int i = 0; i < vertices.size(); i++)
+			positions[i] = vertices[i].Position;
+
+		GPU_MEMORY_OWNER("mesh positions");
+		DepthVAO = GLVertexArray::Create();
+		PositionVBO = GLBuffer::Create();
+
+		glBindVertexArray(DepthVAO);
+
+		glBindBuffer(GL_ARRAY_BUFFER, PositionVBO);
+		glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), &positions[0], GL_STATIC_DRAW);
+
+		// shares the index buffer with the full VAO
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
 
 		glBindVertexArray(0);
 	};
@@ -0,0 +1,206 @@
+#pragma once
+#include "mesh.h"
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+// CPU side result of importing one mesh: everything Mesh needs except GL objects
+struct MeshData {
+	vector<Vertex> vertices;
+	vector<unsigned int> indices;
+	vector<Texture> textures;	// id is not resolved yet, only type and path
+};
+
+// Binary cache of imported meshes (including generated tangents) stored next to
+// the source file as <path>.meshbin. An entry is only used when the source file's
+// size and modification time, those of the material libraries it names (the
+// texture list comes from them), the import flags and the vertex layout all match.
+class MeshCache
+{
+public:
+	static bool Load(const string& path, bool needFlip, vector<MeshData>& meshes)
+	{
+		Header expected;
+		if (!makeHeader(path, needFlip, expected))
+			return false;
+
+		ifstream file(cachePath(path), ios::binary);
+		if (!file)
+			return false;
+
+		Header header;
+		file.read((char*)&header, sizeof(Header));
+		if (!file || memcmp(&header, &expected, sizeof(Header)) != 0)
+			return false;
+
+		unsigned int meshCount = 0;
+		read(file, meshCount);
+		vector<MeshData> result(meshCount);
+		for (unsigned int i = 0; i < meshCount && file; i++)
+		{
+			readVector(file, result[i].vertices);
+			readVector(file, result[i].indices);
+			unsigned int textureCount = 0;
+			read(file, textureCount);
+			result[i].textures.resize(textureCount);
+			for (unsigned int j = 0; j < textureCount && file; j++)
+			{
+				result[i].textures[j].id = 0;
+				readString(file, result[i].textures[j].type);
+				readString(file, result[i].textures[j].path);
+			}
+		}
+
+		if (!file)
+		{
+			cout << "WARNING::MESHCACHE::CORRUPT_ENTRY: " << cachePath(path) << endl;
+			return false;
+		}
+
+		meshes.swap(result);
+		return true;
+	};
+
+	static void Store(const string& path, bool needFlip, const vector<MeshData>& meshes)
+	{
+		Header header;
+		if (!makeHeader(path, needFlip, header))
+			return;
+
+		ofstream file(cachePath(path), ios::binary | ios::trunc);
+		if (!file)
+		{
+			cout << "WARNING::MESHCACHE::CANNOT_WRITE: " << cachePath(path) << endl;
+			return;
+		}
+
+		file.write((const char*)&header, sizeof(Header));
+		write(file, (unsigned int)meshes.size());
+		for (unsigned int i = 0; i < meshes.size(); i++)
+		{
+			writeVector(file, meshes[i].vertices);
+			writeVector(file, meshes[i].indices);
+			write(file, (unsigned int)meshes[i].textures.size());
+			for (unsigned int j = 0; j < meshes[i].textures.size(); j++)
+			{
+				writeString(file, meshes[i].textures[j].type);
+				writeString(file, meshes[i].textures[j].path);
+			}
+		}
+	};
+
+private:
+	static const unsigned int MAGIC = 0x4D474F4C; // "LOGM"
+	static const unsigned int VERSION = 3; // 2: vertices split at mirrored-UV seams, 3: welded vertices, material stamp
+
+	struct Header {
+		unsigned int magic;
+		unsigned int version;
+		unsigned int vertexSize;
+		unsigned int flipUVs;
+		long long sourceSize;
+		long long sourceTime;
+		long long materialSize;	// summed over every mtllib of an .obj
+		long long materialTime;	// latest of them
+	};
+
+	static string cachePath(const string& path)
+	{
+		return path + ".meshbin";
+	};
+
+	static bool makeHeader(const string& path, bool needFlip, Header& header)
+	{
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0)
+			return false;
+
+		memset(&header, 0, sizeof(Header));
+		header.magic = MAGIC;
+		header.version = VERSION;
+		header.vertexSize = sizeof(Vertex);
+		header.flipUVs = needFlip ? 1 : 0;
+		header.sourceSize = (long long)info.st_size;
+		header.sourceTime = (long long)info.st_mtime;
+		stampMaterials(path, header);
+		return true;
+	};
+
+	// the material libraries an .obj references with "mtllib", relative to its directory
+	static void stampMaterials(const string& path, Header& header)
+	{
+		if (path.size() < 4 || path.compare(path.size() - 4, 4, ".obj") != 0)
+			return;
+		ifstream source(path);
+		string directory = path.substr(0, path.find_last_of('/') + 1);
+		string line;
+		while (getline(source, line))
+		{
+			if (line.compare(0, 7, "mtllib ") != 0)
+				continue;
+			string name = line.substr(7);
+			name.erase(name.find_last_not_of(" \t\r") + 1);
+			struct stat info;
+			if (stat((directory + name).c_str(), &info) != 0)
+			{
+				// a missing library still has to differ from an empty one
+				header.materialSize -= 1;
+				continue;
+			}
+			header.materialSize += (long long)info.st_size;
+			header.materialTime = max(header.materialTime, (long long)info.st_mtime);
+		}
+	};
+
+	template <typename T>
+	static void read(ifstream& file, T& value)
+	{
+		file.read((char*)&value, sizeof(T));
+	};
+
+	template <typename T>
+	static void write(ofstream& file, const T& value)
+	{
+		file.write((const char*)&value, sizeof(T));
+	};
+
+	template <typename T>
+	static void readVector(ifstream& file, vector<T>& values)
+	{
+		unsigned int count = 0;
+		read(file, count);
+		if (!file)
+			return;
+		values.resize(count);
+		if (count > 0)
+			file.read((char*)&values[0], count * sizeof(T));
+	};
+
+	template <typename T>
+	static void writeVector(ofstream& file, const vector<T>& values)
+	{
+		write(file, (unsigned int)values.size());
+		if (!values.empty())
+			file.write((const char*)&values[0], values.size() * sizeof(T));
+	};
+
+	static void readString(ifstream& file, string& value)
+	{
+		unsigned int length = 0;
+		read(file, length);
+		if (!file)
+			return;
+		value.resize(length);
+		if (length > 0)
+			file.read(&value[0], length);
+	};
+
+	static void writeString(ofstream& file, const string& value)
+	{
+		write(file, (unsigned int)value.size());
+		if (!value.empty())
+			file.write(value.data(), value.size());
+	};
+};
@@ -1,9 +1,14 @@
 #pragma once
 #include "mesh.h"
+#include "meshcache.h"
+#include "tangentspace.h"
 #include "stb_image.h"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 
 class Model 
@@ -13,7 +18,8 @@ public:
 	vector<Texture> loadedTexture;
 
 
-	Model(string path, bool needFlip = true)
+	// positionStream keeps a position-only copy of every mesh for DrawDepth
+	Model(string path, bool needFlip = true, bool positionStream = false) : positionStream(positionStream)
 	{
 		loadModel(path, needFlip);
 	};
@@ -26,47 +32,106 @@ public:
 		}
 	};
 
+	// true when every mesh has a normal map, i.e. the NORMAL_MAP shader permutation applies to all of them
+	bool HasNormalMaps() const
+	{
+		if (meshes.empty())
+			return false;
+		for (unsigned int i = 0; i < meshes.size(); i++)
+		{
+			bool found = false;
+			for (unsigned int j = 0; j < meshes[i].textures.size(); j++)
+				found = found || meshes[i].textures[j].type == NORMAL_TYPE;
+			if (!found)
+				return false;
+		}
+		return true;
+	};
+
+	void DrawDepth()
+	{
+		for (unsigned int i = 0; i < meshes.size(); i++)
+		{
+			meshes[i].DrawDepth();
+		}
+	};
+
 private:
 	string directory;
+	bool positionStream;
+	// owns the ids in loadedTexture, which meshes share
+	vector<GLTexture> textureHandles;
 
 	void loadModel(string path, bool needFlip)
 	{
-		Assimp::Importer importer;
-		unsigned int Flag = aiProcess_Triangulate;
-		if (needFlip)
-			Flag = Flag | aiProcess_FlipUVs;
-
-		const aiScene* scene = importer.ReadFile(path, Flag);
-		//const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
-		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+		directory = path.substr(0, path.find_last_of('/'));
+
+		vector<MeshData> meshData;
+		if (!MeshCache::Load(path, needFlip, meshData))
 		{
-			cout << "ERROR::ASSIMP::" << importer.GetErrorString() << endl;
-			return;
+			Assimp::Importer importer;
+			// welded corners let TangentSpace::Generate average tangents over the triangles sharing them
+			unsigned int Flag = aiProcess_Triangulate | aiProcess_JoinIdenticalVertices;
+			if (needFlip)
+				Flag = Flag | aiProcess_FlipUVs;
+
+			const aiScene* scene = importer.ReadFile(path, Flag);
+			//const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+			if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+			{
+				cout << "ERROR::ASSIMP::" << importer.GetErrorString() << endl;
+				return;
+			}
+
+			vector<aiMesh*> sceneMeshes;
+			processNode(scene->mRootNode, scene, sceneMeshes);
+
+			meshData.resize(sceneMeshes.size());
+			for (unsigned int i = 0; i < sceneMeshes.size(); i++)
+				meshData[i].textures = collectMaterialTextures(sceneMeshes[i], scene);
+
+			// vertex extraction and tangent generation only touch CPU memory, so each mesh can run on its own worker
+			atomic<unsigned int> next(0);
+			auto worker = [&]()
+			{
+				for (unsigned int i = next++; i < sceneMeshes.size(); i = next++)
+					processMesh(sceneMeshes[i], meshData[i]);
+			};
+			unsigned int workerCount = min((unsigned int)sceneMeshes.size(), max(1u, thread::hardware_concurrency()));
+			vector<thread> workers;
+			for (unsigned int i = 1; i < workerCount; i++)
+				workers.push_back(thread(worker));
+			worker();
+			for (unsigned int i = 0; i < workers.size(); i++)
+				workers[i].join();
+
+			MeshCache::Store(path, needFlip, meshData);
 		}
 
-		directory = path.substr(0, path.find_last_of('/'));
-		processNode(scene->mRootNode, scene);
+		for (unsigned int i = 0; i < meshData.size(); i++)
+			meshes.push_back(Mesh(meshData[i].vertices, meshData[i].indices, loadMaterialTextures(meshData[i].textures), positionStream));
 	};
 
-	void processNode(aiNode* rootnode, const aiScene* scene)
+	void processNode(aiNode* rootnode, const aiScene* scene, vector<aiMesh*>& sceneMeshes)
 	{
 		for (unsigned int i = 0; i < rootnode->mNumMeshes; i++)
 		{
 			aiMesh* mesh = scene->mMeshes[rootnode->mMeshes[i]];
-			meshes.push_back(processMesh(mesh, scene));
+			sceneMeshes.push_back(mesh);
 		}
 
 		for (unsigned int i = 0; i < rootnode->mNumChildren; i++)
 		{
-			processNode(rootnode->mChildren[i], scene);
+			processNode(rootnode->mChildren[i], scene, sceneMeshes);
 		}
 	};
 
-	Mesh processMesh(aiMesh* mesh, const aiScene* scene)
+	void processMesh(aiMesh* mesh, MeshData& data)
 	{
-		vector<Vertex> vertices;
-		vector<unsigned int> indices;
-		vector<Texture> textures;
+		vector<Vertex>& vertices = data.vertices;
+		vector<unsigned int>& indices = data.indices;
+		vertices.reserve(mesh->mNumVertices);
+		indices.reserve(mesh->mNumFaces * 3);
 
 		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
 		{
@@ -93,6 +158,7 @@ private:
 			{
 				vertex.TexCoords = glm::vec2(0.0f, 0.0f);
 			}
+			vertex.Tangent = 0;
 
 			vertices.push_back(vertex);
 		}
@@ -105,44 +171,75 @@ private:
 			}
 		}
 
+		TangentSpace::Generate(vertices, indices);
+	};
+
+	vector<Texture> collectMaterialTextures(aiMesh* mesh, const aiScene* scene)
+	{
+		vector<Texture> textures;
 		if (mesh->mMaterialIndex >= 0)
 		{
 			aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-			vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+			vector<Texture> diffuseMaps = collectMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
 			textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
 
-			vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_sepcular");
+			vector<Texture> specularMaps = collectMaterialTextures(material, aiTextureType_SPECULAR, "texture_sepcular");
 			textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+
+			// obj "map_Bump" is reported as a height map
+			vector<Texture> normalMaps = collectMaterialTextures(material, aiTextureType_NORMALS, NORMAL_TYPE);
+			if (normalMaps.empty())
+				normalMaps = collectMaterialTextures(material, aiTextureType_HEIGHT, NORMAL_TYPE);
+			textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
 		}
 
-		return Mesh(vertices, indices, textures);
+		return textures;
 	};
 
-	vector<Texture> loadMaterialTextures(aiMaterial* material, aiTextureType type, string name)
+	vector<Texture> collectMaterialTextures(aiMaterial* material, aiTextureType type, string name)
 	{
 		vector<Texture> textures;
 		for (unsigned int i = 0; i < material->GetTextureCount(type); i++)
 		{
 			aiString path;
 			material->GetTexture(type, i, &path);
+
+			Texture texture;
+			texture.id = 0;
+			texture.type = name;
+			texture.path = path.C_Str();
+			textures.push_back(texture);
+		}
+
+		return textures;
+	};
+
+	vector<Texture> loadMaterialTextures(const vector<Texture>& materialTextures)
+	{
+		vector<Texture> textures;
+		for (unsigned int i = 0; i < materialTextures.size(); i++)
+		{
+			const Texture& wanted = materialTextures[i];
 			bool skip = false;
 			for (unsigned int j = 0; j < loadedTexture.size(); j++)
 			{
-				if (std::strcmp(loadedTexture[j].path.data(), path.C_Str()) == 0)
+				if (loadedTexture[j].path == wanted.path && loadedTexture[j].type == wanted.type)
 				{
 					textures.push_back(loadedTexture[j]);
 					skip = true;
+					break;
 				}
 			}
 
 			if (!skip)
 			{
 				Texture texture;
-				texture.id = textureFromFile(path.C_Str(), directory);
-				texture.type = name;
-				texture.path = path.C_Str();
+				texture.id = textureFromFile(wanted.path, directory);
+				texture.type = wanted.type;
+				texture.path = wanted.path;
 				textures.push_back(texture);
 				loadedTexture.push_back(texture);
+				textureHandles.push_back(GLTexture(texture.id));
 			}
 		}
 
@@ -154,6 +251,7 @@ private:
 		string filename = string(path);
 		filename = directory + '/' + filename;
 
+		GPU_MEMORY_OWNER("model texture");
 		unsigned int textureID;
 		glGenTextures(1, &textureID);
 
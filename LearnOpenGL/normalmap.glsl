@@ -0,0 +1,26 @@
+// Tangent-space normal mapping for the NORMAL_MAP permutation of vs_clustered.vert:
+// the bitangent is rebuilt from the interpolated normal and tangent, so only
+// one vec4 is interpolated instead of a whole TBN matrix
+
+#ifndef NORMAL_MAP
+#define NORMAL_MAP 0
+#endif
+
+#if NORMAL_MAP
+in vec4 Tangent;
+uniform sampler2D texture_normal1;
+#endif
+
+vec3 SurfaceNormal(vec3 normal, vec2 texCoords)
+{
+    vec3 N = normalize(normal);
+#if NORMAL_MAP
+    // re-orthogonalise, interpolation bends the tangent away from the normal
+    vec3 T = normalize(Tangent.xyz - N * dot(N, Tangent.xyz));
+    vec3 B = cross(N, T) * Tangent.w;
+    vec3 tangentNormal = texture(texture_normal1, texCoords).rgb * 2.0 - 1.0;
+    return normalize(mat3(T, B, N) * tangentNormal);
+#else
+    return N;
+#endif
+}
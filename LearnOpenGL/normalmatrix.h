@@ -0,0 +1,115 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <cstddef>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define LOGL_NORMAL_MATRIX_SSE 1
+#include <xmmintrin.h>
+#endif
+
+// Normal matrices computed on the CPU, once per object instead of once per
+// vertex. The inverse transpose of the upper 3x3 is built from its cofactors:
+// with columns a, b, c it is (b x c, c x a, a x b) / det, three cross products
+// and a division. A matrix that only rotates, translates and scales uniformly
+// maps normals like positions, up to length, so mat3(model) is used as is and
+// the shader variants with NORMAL_MATRIX 0 skip the normal matrix entirely.
+class NormalMatrix
+{
+public:
+    // true when the upper 3x3 is a rotation (or reflection) times one scale factor
+    static bool HasUniformScale(const glm::mat4& model, float tolerance = 1e-4f)
+    {
+        glm::vec3 a(model[0]), b(model[1]), c(model[2]);
+        float aa = glm::dot(a, a);
+        float limit = tolerance * aa;
+        return std::fabs(aa - glm::dot(b, b)) <= limit && std::fabs(aa - glm::dot(c, c)) <= limit
+            && std::fabs(glm::dot(a, b)) <= limit && std::fabs(glm::dot(a, c)) <= limit && std::fabs(glm::dot(b, c)) <= limit;
+    }
+
+    static bool AllUniformScale(const glm::mat4* models, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!HasUniformScale(models[i]))
+                return false;
+        }
+        return true;
+    }
+
+    // what to upload as "normalMatrix", the fragment shaders normalize the result
+    static glm::mat3 FromModel(const glm::mat4& model)
+    {
+        if (HasUniformScale(model))
+            return glm::mat3(model);
+        return Compute(model);
+    }
+
+    // transpose(inverse(mat3(model)))
+    static glm::mat3 Compute(const glm::mat4& model)
+    {
+        glm::vec3 a(model[0]), b(model[1]), c(model[2]);
+        glm::vec3 bc = glm::cross(b, c);
+        float inverseDeterminant = 1.0f / glm::dot(a, bc);
+        return glm::mat3(bc * inverseDeterminant, glm::cross(c, a) * inverseDeterminant, glm::cross(a, b) * inverseDeterminant);
+    }
+
+    // Compute() for a whole instance array, four matrices per SSE iteration:
+    // the columns are transposed so each register holds one component of four
+    // matrices and the cross products run without shuffles. Without SSE every
+    // matrix goes through Compute().
+    static void ComputeBatch(const glm::mat4* models, glm::mat3* normalMatrices, size_t count)
+    {
+        size_t i = 0;
+#ifdef LOGL_NORMAL_MATRIX_SSE
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 x[3], y[3], z[3];
+            for (int column = 0; column < 3; column++)
+            {
+                __m128 m0 = _mm_loadu_ps(&models[i][column][0]);
+                __m128 m1 = _mm_loadu_ps(&models[i + 1][column][0]);
+                __m128 m2 = _mm_loadu_ps(&models[i + 2][column][0]);
+                __m128 m3 = _mm_loadu_ps(&models[i + 3][column][0]);
+                _MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+                x[column] = m0;
+                y[column] = m1;
+                z[column] = m2;
+            }
+
+            // cofactor columns: b x c, c x a, a x b
+            __m128 nx[3], ny[3], nz[3];
+            for (int column = 0; column < 3; column++)
+            {
+                int u = (column + 1) % 3, v = (column + 2) % 3;
+                nx[column] = _mm_sub_ps(_mm_mul_ps(y[u], z[v]), _mm_mul_ps(z[u], y[v]));
+                ny[column] = _mm_sub_ps(_mm_mul_ps(z[u], x[v]), _mm_mul_ps(x[u], z[v]));
+                nz[column] = _mm_sub_ps(_mm_mul_ps(x[u], y[v]), _mm_mul_ps(y[u], x[v]));
+            }
+            __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x[0], nx[0]), _mm_mul_ps(y[0], ny[0])), _mm_mul_ps(z[0], nz[0]));
+            __m128 inverseDeterminant = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+
+            for (int column = 0; column < 3; column++)
+            {
+                __m128 r0 = _mm_mul_ps(nx[column], inverseDeterminant);
+                __m128 r1 = _mm_mul_ps(ny[column], inverseDeterminant);
+                __m128 r2 = _mm_mul_ps(nz[column], inverseDeterminant);
+                __m128 r3 = _mm_setzero_ps();
+                _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+                // glm::mat3 columns are 3 floats, a 4 float store would run past the last one
+                float packed[4][4];
+                _mm_storeu_ps(packed[0], r0);
+                _mm_storeu_ps(packed[1], r1);
+                _mm_storeu_ps(packed[2], r2);
+                _mm_storeu_ps(packed[3], r3);
+                for (int j = 0; j < 4; j++)
+                    std::memcpy(&normalMatrices[i + j][column][0], packed[j], 3 * sizeof(float));
+            }
+        }
+#endif
+        for (; i < count; i++)
+            normalMatrices[i] = Compute(models[i]);
+    }
+};
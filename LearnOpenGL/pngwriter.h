@@ -0,0 +1,119 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <algorithm>
+
+// Minimal PNG encoder for screenshots and test images: 8-bit RGB or RGBA,
+// stored (uncompressed) deflate blocks, so it needs no zlib. Files are larger
+// than usual but byte-identical for identical pixels.
+class PngWriter
+{
+public:
+    // pixels are rows of width * channels bytes, bottom row first when flipVertically
+    // is set (as glReadPixels returns them). channels is 3 or 4.
+    static bool Write(const std::string& path, int width, int height, int channels, const unsigned char* pixels, bool flipVertically)
+    {
+        if (channels != 3 && channels != 4)
+            return false;
+
+        // filter type 0 in front of every row
+        size_t rowSize = (size_t)width * channels;
+        std::vector<unsigned char> raw;
+        raw.reserve((rowSize + 1) * height);
+        for (int y = 0; y < height; y++)
+        {
+            const unsigned char* row = pixels + rowSize * (flipVertically ? height - 1 - y : y);
+            raw.push_back(0);
+            raw.insert(raw.end(), row, row + rowSize);
+        }
+
+        // zlib stream of stored blocks, at most 65535 bytes each
+        std::vector<unsigned char> zlib;
+        zlib.push_back(0x78);
+        zlib.push_back(0x01);
+        size_t offset = 0;
+        do
+        {
+            size_t length = std::min(raw.size() - offset, (size_t)65535);
+            bool last = offset + length == raw.size();
+            zlib.push_back(last ? 1 : 0);
+            zlib.push_back((unsigned char)(length & 0xFF));
+            zlib.push_back((unsigned char)(length >> 8));
+            zlib.push_back((unsigned char)(~length & 0xFF));
+            zlib.push_back((unsigned char)((~length >> 8) & 0xFF));
+            zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+            offset += length;
+        } while (offset < raw.size());
+        appendBigEndian(zlib, adler32(raw));
+
+        std::vector<unsigned char> header;
+        appendBigEndian(header, (uint32_t)width);
+        appendBigEndian(header, (uint32_t)height);
+        header.push_back(8);                        // bit depth
+        header.push_back(channels == 4 ? 6 : 2);    // color type: RGBA or RGB
+        header.push_back(0);                        // deflate
+        header.push_back(0);                        // adaptive filtering
+        header.push_back(0);                        // no interlace
+
+        std::vector<unsigned char> file = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        appendChunk(file, "IHDR", header);
+        appendChunk(file, "IDAT", zlib);
+        appendChunk(file, "IEND", std::vector<unsigned char>());
+
+        std::ofstream stream(path.c_str(), std::ios::binary);
+        if (!stream)
+            return false;
+        stream.write((const char*)file.data(), file.size());
+        return stream.good();
+    }
+
+private:
+    static void appendBigEndian(std::vector<unsigned char>& out, uint32_t value)
+    {
+        for (int shift = 24; shift >= 0; shift -= 8)
+            out.push_back((unsigned char)(value >> shift));
+    }
+
+    static uint32_t adler32(const std::vector<unsigned char>& data)
+    {
+        uint32_t a = 1, b = 0;
+        for (size_t i = 0; i < data.size(); i++)
+        {
+            a = (a + data[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        return (b << 16) | a;
+    }
+
+    static uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc)
+    {
+        static uint32_t table[256];
+        static bool tableReady = false;
+        if (!tableReady)
+        {
+            for (uint32_t n = 0; n < 256; n++)
+            {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                table[n] = c;
+            }
+            tableReady = true;
+        }
+        for (size_t i = 0; i < size; i++)
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return crc;
+    }
+
+    static void appendChunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data)
+    {
+        appendBigEndian(out, (uint32_t)data.size());
+        size_t typeStart = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        uint32_t crc = crc32(&out[typeStart], out.size() - typeStart, 0xFFFFFFFFu) ^ 0xFFFFFFFFu;
+        appendBigEndian(out, crc);
+    }
+};
@@ -0,0 +1,227 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <vector>
+#include <memory>
+#include <iostream>
+
+#include "glhandle.h"
+#include "gpumemory.h"
+
+// what a pooled target holds, targets are shared between passes asking for the same
+struct RenderTargetDesc {
+    int Width = 0;
+    int Height = 0;
+    GLenum ColorFormat = GL_RGBA8;              // 0 for depth-only targets
+    GLenum DepthFormat = GL_DEPTH24_STENCIL8;   // 0 for color-only targets
+    int Samples = 1;
+    bool SampledDepth = false;                  // depth in a texture instead of a renderbuffer
+    GLenum VelocityFormat = 0;                  // a second color texture for motion vectors, e.g. GL_RG16F
+
+    bool operator==(const RenderTargetDesc& other) const
+    {
+        return Width == other.Width && Height == other.Height && ColorFormat == other.ColorFormat && DepthFormat == other.DepthFormat
+            && Samples == other.Samples && SampledDepth == other.SampledDepth && VelocityFormat == other.VelocityFormat;
+    }
+};
+
+// Framebuffer with its attachments. Single-sampled color is a texture the next
+// pass can sample, multisampled color a renderbuffer to resolve with a blit.
+struct RenderTarget {
+    RenderTargetDesc Desc;
+    GLFramebuffer FBO;
+    GLTexture ColorTexture;
+    GLRenderbuffer ColorBuffer;
+    GLTexture VelocityTexture;
+    GLTexture DepthTexture;
+    GLRenderbuffer DepthBuffer;
+
+    // binds the framebuffer with a viewport covering it
+    void Bind() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glViewport(0, 0, Desc.Width, Desc.Height);
+    }
+};
+
+// Hands out transient render targets keyed by size, formats and samples.
+// Acquire() returns a target no pass holds in this frame and allocates one only
+// when none matches, so targets follow the framebuffer size lazily: after a
+// resize the new size is allocated on first use and the old targets, unused
+// for EVICT_FRAMES frames, are dropped (deleted once the GPU is done with them).
+// A pass that is done with its target before the frame ends can Release() it,
+// and a later pass asking for the same description renders into the same memory.
+// DemoRunner owns one pool (Targets()) and ends its frame; demos call Acquire
+// every frame instead of keeping framebuffers of their own, and Create only for
+// targets read in a later frame, such as TAA history.
+class RenderTargetPool
+{
+public:
+    RenderTarget& Acquire(const RenderTargetDesc& desc)
+    {
+        for (Entry& entry : entries)
+        {
+            if (!entry.InUse && entry.Target->Desc == desc)
+            {
+                entry.InUse = true;
+                entry.LastUsed = frame;
+                return *entry.Target;
+            }
+        }
+        Entry entry;
+        entry.Target = Create(desc);
+        entry.InUse = true;
+        entry.LastUsed = frame;
+        entries.push_back(std::move(entry));
+        allocations++;
+        return *entries.back().Target;
+    }
+
+    // a target outside the pool, for ones that keep their content across frames
+    static std::unique_ptr<RenderTarget> Create(const RenderTargetDesc& desc)
+    {
+        GPU_MEMORY_OWNER("target pool");
+        std::unique_ptr<RenderTarget> target(new RenderTarget());
+        target->Desc = desc;
+        target->FBO = GLFramebuffer::Create();
+        glBindFramebuffer(GL_FRAMEBUFFER, target->FBO);
+
+        if (desc.ColorFormat != 0 && desc.Samples > 1)
+        {
+            target->ColorBuffer = GLRenderbuffer::Create();
+            glBindRenderbuffer(GL_RENDERBUFFER, target->ColorBuffer);
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, desc.Samples, desc.ColorFormat, desc.Width, desc.Height);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target->ColorBuffer);
+        }
+        else if (desc.ColorFormat != 0)
+        {
+            target->ColorTexture = GLTexture::Create();
+            glBindTexture(GL_TEXTURE_2D, target->ColorTexture);
+            glTexImage2D(GL_TEXTURE_2D, 0, desc.ColorFormat, desc.Width, desc.Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->ColorTexture, 0);
+        }
+        else
+        {
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        }
+
+        if (desc.VelocityFormat != 0 && desc.ColorFormat != 0 && desc.Samples <= 1)
+        {
+            // nearest: motion vectors must not blend across silhouettes
+            target->VelocityTexture = GLTexture::Create();
+            glBindTexture(GL_TEXTURE_2D, target->VelocityTexture);
+            glTexImage2D(GL_TEXTURE_2D, 0, desc.VelocityFormat, desc.Width, desc.Height, 0, GL_RG, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, target->VelocityTexture, 0);
+            unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+            glDrawBuffers(2, attachments);
+        }
+
+        if (desc.DepthFormat != 0)
+        {
+            GLenum attachment = hasStencil(desc.DepthFormat) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+            if (desc.SampledDepth && desc.Samples <= 1)
+            {
+                target->DepthTexture = GLTexture::Create();
+                glBindTexture(GL_TEXTURE_2D, target->DepthTexture);
+                glTexImage2D(GL_TEXTURE_2D, 0, desc.DepthFormat, desc.Width, desc.Height, 0, hasStencil(desc.DepthFormat) ? GL_DEPTH_STENCIL : GL_DEPTH_COMPONENT,
+                    depthType(desc.DepthFormat), NULL);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, target->DepthTexture, 0);
+            }
+            else
+            {
+                target->DepthBuffer = GLRenderbuffer::Create();
+                glBindRenderbuffer(GL_RENDERBUFFER, target->DepthBuffer);
+                if (desc.Samples > 1)
+                    glRenderbufferStorageMultisample(GL_RENDERBUFFER, desc.Samples, desc.DepthFormat, desc.Width, desc.Height);
+                else
+                    glRenderbufferStorage(GL_RENDERBUFFER, desc.DepthFormat, desc.Width, desc.Height);
+                glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, target->DepthBuffer);
+            }
+        }
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: pooled " << desc.Width << "x" << desc.Height << " target is not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return target;
+    }
+
+    // the caller is done with target for the rest of the frame
+    void Release(const RenderTarget& target)
+    {
+        for (Entry& entry : entries)
+            if (entry.Target.get() == &target)
+                entry.InUse = false;
+    }
+
+    // returns every target to the pool and drops the ones that went unused
+    void EndFrame()
+    {
+        for (size_t i = 0; i < entries.size();)
+        {
+            entries[i].InUse = false;
+            if (frame - entries[i].LastUsed >= EVICT_FRAMES)
+                entries.erase(entries.begin() + i);
+            else
+                i++;
+        }
+        frame++;
+    }
+
+    void Clear()
+    {
+        entries.clear();
+    }
+
+    size_t TargetCount() const
+    {
+        return entries.size();
+    }
+
+    // targets created since the start, a pool that aliases well stops growing it
+    unsigned int Allocations() const
+    {
+        return allocations;
+    }
+
+private:
+    static const unsigned int EVICT_FRAMES = 3;
+
+    struct Entry {
+        std::unique_ptr<RenderTarget> Target;
+        bool InUse = false;
+        unsigned int LastUsed = 0;
+    };
+
+    std::vector<Entry> entries;
+    unsigned int frame = 0;
+    unsigned int allocations = 0;
+
+    static bool hasStencil(GLenum depthFormat)
+    {
+        return depthFormat == GL_DEPTH24_STENCIL8 || depthFormat == GL_DEPTH32F_STENCIL8;
+    }
+
+    static GLenum depthType(GLenum depthFormat)
+    {
+        switch (depthFormat)
+        {
+        case GL_DEPTH24_STENCIL8: return GL_UNSIGNED_INT_24_8;
+        case GL_DEPTH32F_STENCIL8: return GL_FLOAT_32_UNSIGNED_INT_24_8_REV;
+        case GL_DEPTH_COMPONENT32F: return GL_FLOAT;
+        default: return GL_UNSIGNED_INT;
+        }
+    }
+};
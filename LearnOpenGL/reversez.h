@@ -0,0 +1,127 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cstdlib>
+#include <iostream>
+
+#include "shaderpreprocessor.h"
+
+// Reverse-Z depth: the near plane maps to depth 1 and the far plane to 0, so
+// the dense low exponents of a float depth buffer land where perspective
+// leaves the least precision and distant geometry stops z-fighting without
+// moving the near plane. It only pays off on a GL_DEPTH_COMPONENT32F(_STENCIL8)
+// attachment, the default framebuffer's depth is 24-bit fixed point.
+// With GL_ARB_clip_control clip space depth becomes [0, 1] and is stored as is.
+// Without it the [-1, 1] range stays (still reversed) and the window transform
+// costs some of the gain. Shaders see the convention through depth.glsl.
+class ReverseZ
+{
+public:
+    // call once glad is loaded and before creating shadow maps. Sets the clip
+    // convention, the depth test and the depth clear value. LOGL_NO_REVERSE_Z
+    // keeps the conventional setup, to compare the two.
+    static void Enable()
+    {
+        State& s = state();
+        s.enabled = getenv("LOGL_NO_REVERSE_Z") == nullptr;
+        s.zeroToOne = s.enabled && GLAD_GL_ARB_clip_control;
+        if (s.enabled && !s.zeroToOne)
+            std::cout << "WARNING::REVERSE_Z:: GL_ARB_clip_control is not supported, depth stays in [-1, 1]" << std::endl;
+
+        if (GLAD_GL_ARB_clip_control)
+            glClipControl(GL_LOWER_LEFT, s.zeroToOne ? GL_ZERO_TO_ONE : GL_NEGATIVE_ONE_TO_ONE);
+        glClearDepth(FarDepth());
+        glDepthFunc(DepthFunc());
+    }
+
+    static bool Enabled()
+    {
+        return state().enabled;
+    }
+
+    // clip space depth is [0, 1] instead of [-1, 1]
+    static bool ZeroToOne()
+    {
+        return state().zeroToOne;
+    }
+
+    // GL_LESS, or GL_GREATER when reversed
+    static GLenum DepthFunc()
+    {
+        return state().enabled ? GL_GREATER : GL_LESS;
+    }
+
+    // GL_LEQUAL, or GL_GEQUAL when reversed, for geometry drawn at exactly the far plane
+    // and for the compare mode of shadow samplers
+    static GLenum DepthFuncOrEqual()
+    {
+        return state().enabled ? GL_GEQUAL : GL_LEQUAL;
+    }
+
+    // depth buffer value of the far plane, the clear value
+    static float FarDepth()
+    {
+        return state().enabled ? 0.0f : 1.0f;
+    }
+
+    // glm::perspective, with depth mapped to the active convention
+    static glm::mat4 Perspective(float fovY, float aspect, float zNear, float zFar)
+    {
+        glm::mat4 projection = glm::perspective(fovY, aspect, zNear, zFar);
+        if (!state().enabled)
+            return projection;
+        // view z = -near lands on 1, -far on 0 (or -1)
+        if (state().zeroToOne)
+        {
+            projection[2][2] = zNear / (zFar - zNear);
+            projection[3][2] = zFar * zNear / (zFar - zNear);
+        }
+        else
+        {
+            projection[2][2] = (zFar + zNear) / (zFar - zNear);
+            projection[3][2] = 2.0f * zFar * zNear / (zFar - zNear);
+        }
+        return projection;
+    }
+
+    // glm::ortho, with depth mapped to the active convention
+    static glm::mat4 Ortho(float left, float right, float bottom, float top, float zNear, float zFar)
+    {
+        glm::mat4 projection = glm::ortho(left, right, bottom, top, zNear, zFar);
+        if (!state().enabled)
+            return projection;
+        if (state().zeroToOne)
+        {
+            projection[2][2] = 1.0f / (zFar - zNear);
+            projection[3][2] = zFar / (zFar - zNear);
+        }
+        else
+        {
+            projection[2][2] = 2.0f / (zFar - zNear);
+            projection[3][2] = (zFar + zNear) / (zFar - zNear);
+        }
+        return projection;
+    }
+
+    // REVERSE_Z and DEPTH_ZERO_TO_ONE for shaders including depth.glsl
+    static ShaderDefines Defines(ShaderDefines defines = ShaderDefines())
+    {
+        defines.Set("REVERSE_Z", state().enabled);
+        defines.Set("DEPTH_ZERO_TO_ONE", state().zeroToOne);
+        return defines;
+    }
+
+private:
+    struct State {
+        bool enabled = false;
+        bool zeroToOne = false;
+    };
+
+    static State& state()
+    {
+        static State s;
+        return s;
+    }
+};
@@ -8,6 +8,14 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+#include <cstdlib>
+
+#include "shaderpreprocessor.h"
+#include "shadercache.h"
 
 class Shader
 {
@@ -17,125 +25,238 @@ public:
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
     {
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        try
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-
-            if (geometryPath != nullptr)
-            {
-                std::stringstream gShaderStream;
-                gShaderFile.open(geometryPath);
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-
-            }
-        }
-        catch (std::ifstream::failure& e)
-        {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
-        }
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment, geometry;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // geometry Shader
-        if (geometryPath != nullptr)
-        {
-            const char* gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
-        }
-       
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if (geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessary
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if (geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        submit(vertexPath, fragmentPath, geometryPath, ShaderDefines());
+        Wait();
+    }
+    // same as above but compiles the permutation selected by defines
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath, const ShaderDefines& defines)
+    {
+        submit(vertexPath, fragmentPath, geometryPath, defines);
+        Wait();
+    }
+    // only submits the compile and link to the driver and returns straight away.
+    // The program is finished (and errors reported) by Wait() or the first use().
+    // Copies share the pending state.
+    // ------------------------------------------------------------------------
+    static Shader Async(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const ShaderDefines& defines = ShaderDefines())
+    {
+        Shader shader;
+        shader.submit(vertexPath, fragmentPath, geometryPath, defines);
+        return shader;
+    }
+    // non-blocking completion poll through GL_COMPLETION_STATUS_KHR. Without
+    // KHR/ARB_parallel_shader_compile there is no way to ask and the driver links on
+    // the submitting thread anyway, so it reports ready and Wait() only reads the result
+    // ------------------------------------------------------------------------
+    bool IsReady() const
+    {
+        if (!pending || pending->finished || pending->fromCache)
+            return true;
+        if (!ParallelCompileSupported())
+            return true;
+        int complete = GL_FALSE;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &complete);
+        return complete == GL_TRUE;
+    }
+    // blocks until the program is linked, reports errors and fills the binary cache
+    // ------------------------------------------------------------------------
+    void Wait()
+    {
+        if (pending && !pending->finished)
+            finish(*pending);
+        pending.reset();
+    }
+    // ------------------------------------------------------------------------
+    // LOGL_NO_PARALLEL_COMPILE takes the path of drivers without the extension
+    static bool ParallelCompileSupported()
+    {
+        static const bool disabled = getenv("LOGL_NO_PARALLEL_COMPILE") != nullptr;
+        return !disabled && (GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile);
+    }
+    // lets the driver spawn as many compiler threads as it wants, call once per
+    // context before submitting a batch of Async() shaders
+    // ------------------------------------------------------------------------
+    static void EnableParallelCompile()
+    {
+        if (!ParallelCompileSupported())
+            return;
+        if (GLAD_GL_KHR_parallel_shader_compile)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        else
+            glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use()
     {
+        Wait();
         glUseProgram(ID);
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string& name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        glUniform1i(getUniformLocation(name), (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string& name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1i(getUniformLocation(name), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string& name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1f(getUniformLocation(name), value);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string& name, const glm::vec3 value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3fv(getUniformLocation(name), 1, &value[0]);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string& name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform3f(getUniformLocation(name), x, y, z);
+    }
+    // ------------------------------------------------------------------------
+    void setMat3(const std::string& name, const glm::mat3 value) const
+    {
+        glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, &value[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string& name, const glm::mat4 value) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &value[0][0]);
+        glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, &value[0][0]);
+    }
+    // true once the program linked successfully, blocks like Wait() for pending programs
+    // ------------------------------------------------------------------------
+    bool IsLinked()
+    {
+        Wait();
+        int linked = GL_FALSE;
+        glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+        return linked == GL_TRUE;
     }
 
 private:
+    // state of a program whose compile/link has been submitted but not checked yet
+    struct PendingProgram {
+        bool finished;
+        bool fromCache;
+        unsigned int stages[3];
+        unsigned int stageCount;
+        std::string name;
+        std::string cacheKey;
+        std::chrono::high_resolution_clock::time_point start;
+    };
+    std::shared_ptr<PendingProgram> pending;
+    // resolved once per program, a reloaded program starts with an empty cache
+    mutable std::unordered_map<std::string, int> uniformLocations;
+
+    Shader() : ID(0)
+    {
+    }
+
+    void submit(const char* vertexPath, const char* fragmentPath, const char* geometryPath, const ShaderDefines& defines)
+    {
+        pending = std::make_shared<PendingProgram>();
+        PendingProgram& program = *pending;
+        program.finished = false;
+        program.fromCache = false;
+        program.stageCount = 0;
+        program.start = std::chrono::high_resolution_clock::now();
+        program.name = std::string(vertexPath) + " " + fragmentPath + (geometryPath != nullptr ? std::string(" ") + geometryPath : std::string());
+        if (!defines.Empty())
+            program.name += " [" + defines.Key() + "]";
+
+        // 1. retrieve the vertex/fragment source code from filePath, expanding #include and injecting defines
+        std::string vertexCode = ShaderPreprocessor::Process(vertexPath, defines);
+        std::string fragmentCode = ShaderPreprocessor::Process(fragmentPath, defines);
+        std::string geometryCode;
+        if (geometryPath != nullptr)
+            geometryCode = ShaderPreprocessor::Process(geometryPath, defines);
+
+        // 2. try the on-disk program binary cache first
+        std::vector<std::string> sources;
+        sources.push_back(vertexCode);
+        sources.push_back(fragmentCode);
+        sources.push_back(geometryCode);
+        program.cacheKey = ShaderBinaryCache::MakeKey(sources, defines);
+
+        ID = glCreateProgram();
+        if (ShaderBinaryCache::Load(ID, program.cacheKey))
+        {
+            program.fromCache = true;
+            return;
+        }
+        // a rejected binary leaves the program in a failed state, start over with a fresh one
+        glDeleteProgram(ID);
+
+        // 3. hand every stage and the link to the driver without querying any status,
+        // so with parallel shader compile the work overlaps with whatever comes next
+        ID = glCreateProgram();
+        if (ShaderBinaryCache::Enabled())
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        program.stages[program.stageCount++] = compileStage(GL_VERTEX_SHADER, vertexCode);
+        program.stages[program.stageCount++] = compileStage(GL_FRAGMENT_SHADER, fragmentCode);
+        if (geometryPath != nullptr)
+            program.stages[program.stageCount++] = compileStage(GL_GEOMETRY_SHADER, geometryCode);
+        for (unsigned int i = 0; i < program.stageCount; i++)
+            glAttachShader(ID, program.stages[i]);
+        glLinkProgram(ID);
+    }
+
+    int getUniformLocation(const std::string& name) const
+    {
+        std::unordered_map<std::string, int>::const_iterator it = uniformLocations.find(name);
+        if (it != uniformLocations.end())
+            return it->second;
+        int location = glGetUniformLocation(ID, name.c_str());
+        // an unfinished program has no uniforms yet, so don't remember the miss
+        if (!pending || pending->finished)
+            uniformLocations[name] = location;
+        return location;
+    }
+
+    unsigned int compileStage(GLenum type, const std::string& code)
+    {
+        const char* source = code.c_str();
+        unsigned int stage = glCreateShader(type);
+        glShaderSource(stage, 1, &source, NULL);
+        glCompileShader(stage);
+        return stage;
+    }
+
+    void finish(PendingProgram& program)
+    {
+        program.finished = true;
+        if (program.fromCache)
+        {
+            ShaderBinaryCache::RecordHit(program.name, elapsedMs(program.start));
+            return;
+        }
+
+        static const char* stageNames[3] = { "VERTEX", "FRAGMENT", "GEOMETRY" };
+        for (unsigned int i = 0; i < program.stageCount; i++)
+            checkCompileErrors(program.stages[i], stageNames[i]);
+        checkCompileErrors(ID, "PROGRAM");
+        // delete the shaders as they're linked into our program now and no longer necessary
+        for (unsigned int i = 0; i < program.stageCount; i++)
+            glDeleteShader(program.stages[i]);
+
+        int linked;
+        glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+        if (linked)
+            ShaderBinaryCache::Store(ID, program.cacheKey);
+        ShaderBinaryCache::RecordMiss(program.name, elapsedMs(program.start));
+    }
+
+    static double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(unsigned int shader, std::string type)
@@ -161,4 +282,45 @@ private:
             }
         }
     }
+};
+
+// submits a group of programs up front so their compiles run in parallel with
+// each other and with asset loading; Progress() can drive a loading screen
+class ShaderBatch
+{
+public:
+    ShaderBatch()
+    {
+        Shader::EnableParallelCompile();
+    }
+
+    Shader Add(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const ShaderDefines& defines = ShaderDefines())
+    {
+        Shader shader = Shader::Async(vertexPath, fragmentPath, geometryPath, defines);
+        shaders.push_back(shader);
+        return shader;
+    }
+
+    // fraction of programs that finished compiling, never blocks when parallel compile is available
+    float Progress() const
+    {
+        if (shaders.empty())
+            return 1.0f;
+        unsigned int ready = 0;
+        for (unsigned int i = 0; i < shaders.size(); i++)
+        {
+            if (shaders[i].IsReady())
+                ready++;
+        }
+        return (float)ready / (float)shaders.size();
+    }
+
+    void WaitAll()
+    {
+        for (unsigned int i = 0; i < shaders.size(); i++)
+            shaders[i].Wait();
+    }
+
+private:
+    std::vector<Shader> shaders;
 };
\ No newline at end of file
@@ -0,0 +1,214 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include "shaderpreprocessor.h"
+
+// On-disk cache of linked program binaries (glGetProgramBinary/glProgramBinary).
+// Entries live in shadercache/<key>.bin where the key hashes the preprocessed
+// sources, the define set and the GL vendor/renderer/version strings, so a
+// driver update or an edited include simply misses. Set LOGL_NO_SHADER_CACHE
+// to always compile from source.
+class ShaderBinaryCache
+{
+public:
+    struct Stats {
+        unsigned int hits;
+        unsigned int misses;
+        unsigned int rejected;
+        double hitMs;
+        double missMs;
+    };
+
+    static bool Enabled()
+    {
+        static bool enabled = getenv("LOGL_NO_SHADER_CACHE") == nullptr && GLAD_GL_ARB_get_program_binary && binaryFormatCount() > 0;
+        return enabled;
+    }
+
+    static std::string MakeKey(const std::vector<std::string>& sources, const ShaderDefines& defines)
+    {
+        unsigned long long hash = FNV_OFFSET;
+        for (unsigned int i = 0; i < sources.size(); i++)
+        {
+            hash = fnv1a(sources[i], hash);
+            hash = fnv1a("\x1f", hash);
+        }
+        hash = fnv1a(defines.Key(), hash);
+        hash = fnv1a(driverString(), hash);
+
+        std::stringstream key;
+        key << std::hex << std::setw(16) << std::setfill('0') << hash;
+        return key.str();
+    }
+
+    // loads the cached binary for key into program. Returns false on a miss or
+    // when the driver rejects the binary (the program is then left unlinked).
+    static bool Load(unsigned int program, const std::string& key)
+    {
+        if (!Enabled())
+            return false;
+
+        std::ifstream file(entryPath(key), std::ios::binary);
+        if (!file)
+            return false;
+
+        Header header;
+        file.read((char*)&header, sizeof(Header));
+        if (!file || header.magic != MAGIC || header.version != VERSION || header.length <= 0)
+            return false;
+
+        std::vector<char> binary(header.length);
+        file.read(&binary[0], header.length);
+        if (!file)
+            return false;
+
+        glProgramBinary(program, header.format, &binary[0], header.length);
+        int success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            GetStats().rejected++;
+            std::cout << "WARNING::SHADER::CACHE_REJECTED: " << key << " is recompiled" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // program must be linked and created with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+    static void Store(unsigned int program, const std::string& key)
+    {
+        if (!Enabled())
+            return;
+
+        int length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        GLsizei written = 0;
+        glGetProgramBinary(program, length, &written, &format, &binary[0]);
+        if (written <= 0)
+            return;
+
+        makeDirectory(cacheDirectory().c_str());
+        std::ofstream file(entryPath(key), std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            std::cout << "WARNING::SHADER::CACHE_NOT_WRITABLE: " << entryPath(key) << std::endl;
+            return;
+        }
+
+        Header header;
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.format = format;
+        header.length = written;
+        file.write((const char*)&header, sizeof(Header));
+        file.write(&binary[0], written);
+    }
+
+    static void RecordHit(const std::string& name, double ms)
+    {
+        GetStats().hits++;
+        GetStats().hitMs += ms;
+        std::cout << "SHADER::CACHE::HIT  " << std::fixed << std::setprecision(2) << ms << " ms  " << name << std::endl;
+    }
+
+    static void RecordMiss(const std::string& name, double ms)
+    {
+        GetStats().misses++;
+        GetStats().missMs += ms;
+        std::cout << "SHADER::CACHE::MISS " << std::fixed << std::setprecision(2) << ms << " ms  " << name << std::endl;
+    }
+
+    static Stats& GetStats()
+    {
+        static Stats s = { 0, 0, 0, 0.0, 0.0 };
+        return s;
+    }
+
+    static void PrintStats()
+    {
+        const Stats& s = GetStats();
+        std::cout << "SHADER::CACHE " << (Enabled() ? "enabled" : "disabled")
+            << ": " << s.hits << " hits (" << std::fixed << std::setprecision(2) << s.hitMs << " ms), "
+            << s.misses << " misses (" << s.missMs << " ms), "
+            << s.rejected << " rejected" << std::endl;
+    }
+
+private:
+    static const unsigned int MAGIC = 0x4253474C; // "LGSB"
+    static const unsigned int VERSION = 1;
+    static const unsigned long long FNV_OFFSET = 14695981039346656037ULL;
+    static const unsigned long long FNV_PRIME = 1099511628211ULL;
+
+    struct Header {
+        unsigned int magic;
+        unsigned int version;
+        unsigned int format;
+        int length;
+    };
+
+    static std::string cacheDirectory()
+    {
+        return "shadercache";
+    }
+
+    static std::string entryPath(const std::string& key)
+    {
+        return cacheDirectory() + "/" + key + ".bin";
+    }
+
+    static unsigned long long fnv1a(const std::string& data, unsigned long long hash)
+    {
+        for (unsigned int i = 0; i < data.size(); i++)
+        {
+            hash ^= (unsigned char)data[i];
+            hash *= FNV_PRIME;
+        }
+        return hash;
+    }
+
+    static int binaryFormatCount()
+    {
+        int formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats;
+    }
+
+    static const std::string& driverString()
+    {
+        static std::string driver = glString(GL_VENDOR) + "|" + glString(GL_RENDERER) + "|" + glString(GL_VERSION);
+        return driver;
+    }
+
+    static std::string glString(GLenum name)
+    {
+        const GLubyte* value = glGetString(name);
+        return value != nullptr ? std::string((const char*)value) : std::string();
+    }
+
+    static void makeDirectory(const char* path)
+    {
+#ifdef _WIN32
+        _mkdir(path);
+#else
+        mkdir(path, 0755);
+#endif
+    }
+};
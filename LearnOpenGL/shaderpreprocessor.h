@@ -0,0 +1,194 @@
+#pragma once
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+// a set of #define NAME VALUE lines injected right after #version. Two define
+// sets with the same Key() produce the same shader permutation.
+class ShaderDefines
+{
+public:
+    ShaderDefines& Set(const std::string& name, const std::string& value = "1")
+    {
+        values[name] = value;
+        return *this;
+    }
+
+    ShaderDefines& Set(const std::string& name, const char* value)
+    {
+        return Set(name, std::string(value));
+    }
+
+    ShaderDefines& Set(const std::string& name, int value)
+    {
+        return Set(name, std::to_string(value));
+    }
+
+    ShaderDefines& Set(const std::string& name, bool value)
+    {
+        return Set(name, value ? 1 : 0);
+    }
+
+    // stable permutation key, e.g. "NORMAL_MAP=1;SHADOW_FILTER=2"
+    std::string Key() const
+    {
+        std::string key;
+        for (std::map<std::string, std::string>::const_iterator it = values.begin(); it != values.end(); ++it)
+        {
+            if (!key.empty())
+                key += ";";
+            key += it->first + "=" + it->second;
+        }
+        return key;
+    }
+
+    std::string Source() const
+    {
+        std::string source;
+        for (std::map<std::string, std::string>::const_iterator it = values.begin(); it != values.end(); ++it)
+            source += "#define " + it->first + " " + it->second + "\n";
+        return source;
+    }
+
+    bool Empty() const
+    {
+        return values.empty();
+    }
+
+private:
+    std::map<std::string, std::string> values;
+};
+
+// expands #include "file" (relative to the including file, each file included
+// once) and injects a define set, so shared GLSL lives in *.glsl files and one
+// source can be compiled into several specialized permutations.
+class ShaderPreprocessor
+{
+public:
+    // files receives every file the result was built from (the root first)
+    static std::string Process(const std::string& path, const ShaderDefines& defines = ShaderDefines(), std::vector<std::string>* files = nullptr)
+    {
+        std::vector<std::string> sourceFiles;
+        std::set<std::string> included;
+        std::string body;
+        if (!expand(path, body, sourceFiles, included, 0))
+            return std::string();
+
+        if (files != nullptr)
+            *files = sourceFiles;
+
+        // #version has to stay the very first statement
+        std::string header;
+        size_t versionPos = body.find("#version");
+        if (versionPos != std::string::npos)
+        {
+            size_t lineEnd = body.find('\n', versionPos);
+            if (lineEnd == std::string::npos)
+                lineEnd = body.size();
+            else
+                lineEnd++;
+            header = body.substr(0, lineEnd);
+            body = body.substr(lineEnd);
+        }
+
+        if (defines.Empty())
+            return header + body;
+        return header + defines.Source() + "#line " + std::to_string(versionPos != std::string::npos ? 2 : 1) + " 0\n" + body;
+    }
+
+    static std::string ReadFile(const std::string& path)
+    {
+        std::ifstream file;
+        file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            file.open(path);
+            std::stringstream stream;
+            stream << file.rdbuf();
+            file.close();
+            return stream.str();
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path << " " << e.what() << std::endl;
+        }
+        return std::string();
+    }
+
+private:
+    static const int MAX_INCLUDE_DEPTH = 16;
+
+    static bool expand(const std::string& path, std::string& out, std::vector<std::string>& files, std::set<std::string>& included, int depth)
+    {
+        if (depth > MAX_INCLUDE_DEPTH)
+        {
+            std::cout << "ERROR::SHADER::INCLUDE_TOO_DEEP: " << path << std::endl;
+            return false;
+        }
+
+        std::string source = ReadFile(path);
+        if (source.empty())
+            return false;
+
+        int fileIndex = (int)files.size();
+        files.push_back(path);
+        included.insert(path);
+
+        std::istringstream lines(source);
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(lines, line))
+        {
+            lineNumber++;
+            std::string includePath;
+            if (!parseInclude(line, includePath))
+            {
+                out += line;
+                out += "\n";
+                continue;
+            }
+
+            std::string resolved = directoryOf(path) + includePath;
+            if (included.count(resolved) == 0)
+            {
+                out += "#line 1 " + std::to_string(files.size()) + "\n";
+                if (!expand(resolved, out, files, included, depth + 1))
+                {
+                    std::cout << "ERROR::SHADER::INCLUDE_FAILED: " << resolved << " included from " << path << ":" << lineNumber << std::endl;
+                    return false;
+                }
+            }
+            out += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+        }
+        return true;
+    }
+
+    static bool parseInclude(const std::string& line, std::string& includePath)
+    {
+        size_t pos = line.find_first_not_of(" \t");
+        if (pos == std::string::npos || line.compare(pos, 8, "#include") != 0)
+            return false;
+
+        size_t open = line.find_first_of("\"<", pos + 8);
+        if (open == std::string::npos)
+            return false;
+        size_t close = line.find_first_of("\">", open + 1);
+        if (close == std::string::npos)
+            return false;
+
+        includePath = line.substr(open + 1, close - open - 1);
+        return true;
+    }
+
+    static std::string directoryOf(const std::string& path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        if (slash == std::string::npos)
+            return std::string();
+        return path.substr(0, slash + 1);
+    }
+};
@@ -0,0 +1,306 @@
+#pragma once
+#include "shader.h"
+#include "glhandle.h"
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <cstdlib>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+// Owns programs loaded through it and reloads them while the app runs. A
+// background thread watches every file a program was built from (includes
+// too) with inotify, or by polling modification times where inotify does not
+// exist. Update() runs on the GL thread once per frame: it submits changed
+// programs asynchronously and swaps one in only after it linked, so a typo in a
+// shader just prints the error and keeps the old program running.
+// LOGL_SHADER_RELOAD_CHECK reloads every program on the first Update() and
+// fails ReloadCheckFailed() when one has not been swapped in RELOAD_CHECK_FRAMES
+// frames later. With LOGL_NO_SHADER_CACHE the unchanged sources are really
+// compiled instead of coming back from the binary cache, and with
+// LOGL_NO_PARALLEL_COMPILE the check covers drivers without parallel compile:
+//   LOGL_HEADLESS=15 LOGL_SHADER_RELOAD_CHECK=1 LOGL_NO_SHADER_CACHE=1 LOGL_NO_PARALLEL_COMPILE=1 ./MainDepthMap
+class ShaderRegistry
+{
+public:
+    // called after the first build and after every successful reload, to set
+    // sampler units and other uniforms that are only assigned once
+    typedef std::function<void(Shader&)> SetupCallback;
+
+    ShaderRegistry() : reloadCheck(getenv("LOGL_SHADER_RELOAD_CHECK") != nullptr), running(true)
+    {
+#ifdef __linux__
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotifyFd < 0)
+            std::cout << "WARNING::SHADER_REGISTRY::INOTIFY_UNAVAILABLE, falling back to polling" << std::endl;
+#endif
+        watcher = std::thread(&ShaderRegistry::watch, this);
+    }
+
+    ~ShaderRegistry()
+    {
+        running = false;
+        watcher.join();
+#ifdef __linux__
+        if (inotifyFd >= 0)
+            close(inotifyFd);
+#endif
+    }
+
+    // the returned reference stays valid for the registry's lifetime, reloads swap the program inside it
+    Shader& Load(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const ShaderDefines& defines = ShaderDefines(), SetupCallback setup = SetupCallback())
+    {
+        entries.push_back(Entry(Shader(vertexPath, fragmentPath, geometryPath, defines)));
+        Entry& entry = entries.back();
+        entry.vertexPath = vertexPath;
+        entry.fragmentPath = fragmentPath;
+        entry.geometryPath = geometryPath != nullptr ? geometryPath : "";
+        entry.defines = defines;
+        entry.setup = setup;
+        entry.reloading = false;
+        entry.dirty = false;
+
+        if (entry.setup)
+        {
+            entry.shader.use();
+            entry.setup(entry.shader);
+        }
+        watchDependencies(entry);
+        return entry.shader;
+    }
+
+    // rebuilds every program as if its sources had changed
+    void ReloadAll()
+    {
+        for (std::list<Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+            it->dirty = true;
+    }
+
+    bool ReloadCheckFailed() const
+    {
+        return reloadCheckFailed;
+    }
+
+    // call once per frame on the thread that owns the GL context
+    void Update()
+    {
+        if (reloadCheck && updates == 0)
+            ReloadAll();
+
+        std::set<std::string> changed;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            changed.swap(changedFiles);
+        }
+
+        for (std::list<Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+        {
+            Entry& entry = *it;
+            for (unsigned int i = 0; i < entry.dependencies.size() && !entry.dirty; i++)
+                entry.dirty = changed.count(entry.dependencies[i]) > 0;
+
+            // start a rebuild, a newer edit during a rebuild queues another one
+            if (entry.dirty && !entry.reloading)
+            {
+                std::cout << "SHADER::RELOAD " << entry.fragmentPath << std::endl;
+                entry.candidate = Shader::Async(entry.vertexPath.c_str(), entry.fragmentPath.c_str(), entry.geometryPath.empty() ? nullptr : entry.geometryPath.c_str(), entry.defines);
+                entry.reloading = true;
+                entry.dirty = false;
+            }
+
+            if (entry.reloading && entry.candidate.IsReady())
+                finishReload(entry);
+        }
+
+        if (reloadCheck && ++updates == RELOAD_CHECK_FRAMES)
+        {
+            unsigned int stuck = 0;
+            for (std::list<Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+                stuck += it->reloading || it->dirty ? 1 : 0;
+            reloadCheckFailed = stuck > 0 || reloadFailures > 0;
+            if (reloadCheckFailed)
+                std::cout << "ERROR::SHADER_REGISTRY::RELOAD_CHECK " << stuck << " programs never finished reloading, " << reloadFailures << " failed to link" << std::endl;
+            else
+                std::cout << "SHADER::RELOAD_CHECK " << entries.size() << " programs reloaded" << (Shader::ParallelCompileSupported() ? "" : " without parallel compile") << std::endl;
+        }
+    }
+
+private:
+    struct Entry {
+        Entry(const Shader& shader) : shader(shader), candidate(shader)
+        {
+        }
+
+        Shader shader;
+        Shader candidate;
+        std::string vertexPath;
+        std::string fragmentPath;
+        std::string geometryPath;
+        ShaderDefines defines;
+        SetupCallback setup;
+        std::vector<std::string> dependencies;
+        bool reloading;
+        bool dirty;
+    };
+
+    static const unsigned int RELOAD_CHECK_FRAMES = 10;
+
+    std::list<Entry> entries;
+    bool reloadCheck;
+    bool reloadCheckFailed = false;
+    unsigned int updates = 0;
+    unsigned int reloadFailures = 0;
+    std::thread watcher;
+    std::atomic<bool> running;
+    std::mutex mutex;
+    std::set<std::string> changedFiles;                     // guarded by mutex
+    std::map<std::string, long long> watchedFiles;          // guarded by mutex, path -> mtime
+#ifdef __linux__
+    int inotifyFd;
+    std::map<int, std::string> watchedDirectories;          // guarded by mutex, watch descriptor -> directory
+#endif
+
+    void finishReload(Entry& entry)
+    {
+        entry.reloading = false;
+        if (!entry.candidate.IsLinked())
+        {
+            std::cout << "SHADER::RELOAD_FAILED keeping the previous program for " << entry.fragmentPath << std::endl;
+            reloadFailures++;
+            GLDeletionQueue::Delete(GLDeletionQueue::PROGRAM, entry.candidate.ID);
+            entry.candidate = entry.shader;
+            return;
+        }
+
+        // frames in flight may still draw with the old program
+        GLDeletionQueue::Delete(GLDeletionQueue::PROGRAM, entry.shader.ID);
+        // the new copy brings an empty uniform location cache, so locations are resolved again on next set*
+        entry.shader = entry.candidate;
+        if (entry.setup)
+        {
+            entry.shader.use();
+            entry.setup(entry.shader);
+        }
+        // an edit may have added or removed includes
+        watchDependencies(entry);
+    }
+
+    void watchDependencies(Entry& entry)
+    {
+        std::vector<std::string> files;
+        const std::string* paths[3] = { &entry.vertexPath, &entry.fragmentPath, &entry.geometryPath };
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            if (paths[i]->empty())
+                continue;
+            std::vector<std::string> stageFiles;
+            ShaderPreprocessor::Process(*paths[i], entry.defines, &stageFiles);
+            files.insert(files.end(), stageFiles.begin(), stageFiles.end());
+        }
+        entry.dependencies = files;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (unsigned int i = 0; i < files.size(); i++)
+        {
+            if (watchedFiles.count(files[i]) == 0)
+                watchedFiles[files[i]] = modificationTime(files[i]);
+#ifdef __linux__
+            if (inotifyFd >= 0)
+            {
+                // watch the directory, editors often save by writing a new file and renaming it over the old one
+                std::string directory = directoryOf(files[i]);
+                int wd = inotify_add_watch(inotifyFd, directory.empty() ? "." : directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+                if (wd >= 0)
+                    watchedDirectories[wd] = directory;
+            }
+#endif
+        }
+    }
+
+    void watch()
+    {
+        while (running)
+        {
+#ifdef __linux__
+            if (inotifyFd >= 0)
+            {
+                readEvents();
+                continue;
+            }
+#endif
+            pollModificationTimes();
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        }
+    }
+
+#ifdef __linux__
+    void readEvents()
+    {
+        pollfd fd;
+        fd.fd = inotifyFd;
+        fd.events = POLLIN;
+        if (poll(&fd, 1, 100) <= 0)
+            return;
+
+        char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        ssize_t length;
+        while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (char* ptr = buffer; ptr < buffer + length; ptr += sizeof(struct inotify_event) + ((struct inotify_event*)ptr)->len)
+            {
+                const struct inotify_event* event = (const struct inotify_event*)ptr;
+                if (event->len == 0 || watchedDirectories.count(event->wd) == 0)
+                    continue;
+                std::string path = watchedDirectories[event->wd] + event->name;
+                if (watchedFiles.count(path) > 0)
+                    changedFiles.insert(path);
+            }
+        }
+    }
+#endif
+
+    void pollModificationTimes()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (std::map<std::string, long long>::iterator it = watchedFiles.begin(); it != watchedFiles.end(); ++it)
+        {
+            long long time = modificationTime(it->first);
+            if (time != it->second)
+            {
+                it->second = time;
+                changedFiles.insert(it->first);
+            }
+        }
+    }
+
+    static long long modificationTime(const std::string& path)
+    {
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0)
+            return 0;
+        return (long long)info.st_mtime;
+    }
+
+    static std::string directoryOf(const std::string& path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        if (slash == std::string::npos)
+            return std::string();
+        return path.substr(0, slash + 1);
+    }
+};
@@ -0,0 +1,133 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <iostream>
+
+#include "cascadedshadows.h"
+
+// Keeps the static casters of every cascade in a second depth array. A layer
+// is redrawn only when its cascade matrix changed (the camera moved it, or the
+// light turned) or a static caster inside it moved, otherwise Render() just
+// blits the cached depth into the live shadow map and draws the dynamic casters
+// on top, so the shadow pass costs about as much as the dynamic objects do.
+// Pair it with CascadedShadowMap::SetQuantizedPlacement(true) and mark moving
+// casters ShadowCaster::Dynamic, so they do not move the cascade matrices.
+class StaticShadowCache
+{
+public:
+    // draws the casters of one cascade, the light space matrix uniform is already set
+    typedef std::function<void(int cascade)> DrawCasters;
+
+    StaticShadowCache(const CascadedShadowMap& shadowMap) : staticRedraws(0)
+    {
+        resolution = shadowMap.Resolution();
+        cascadeCount = shadowMap.CascadeCount();
+
+        GPU_MEMORY_OWNER("shadow cache");
+        glGenTextures(1, &cacheArray);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, cacheArray);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, resolution, resolution, cascadeCount, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        glGenFramebuffers(1, &cacheFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, cacheFBO);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cacheArray, 0, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: Static shadow cache is not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        Invalidate();
+    }
+
+    ~StaticShadowCache()
+    {
+        glDeleteFramebuffers(1, &cacheFBO);
+        glDeleteTextures(1, &cacheArray);
+    }
+
+    // drops every layer, e.g. after static objects were added or removed
+    void Invalidate()
+    {
+        for (int i = 0; i < CascadedShadowMap::MAX_CASCADES; i++)
+            valid[i] = false;
+    }
+
+    // drops the layers whose area a static caster covered, call it with the old and the new bounds when one moves
+    void InvalidateBounds(const ShadowCaster& bounds)
+    {
+        for (int c = 0; c < cascadeCount; c++)
+        {
+            if (!valid[c])
+                continue;
+            glm::vec2 ndcMin(1e30f), ndcMax(-1e30f);
+            for (int i = 0; i < 8; i++)
+            {
+                glm::vec3 corner((i & 1) ? bounds.BoundsMax.x : bounds.BoundsMin.x, (i & 2) ? bounds.BoundsMax.y : bounds.BoundsMin.y, (i & 4) ? bounds.BoundsMax.z : bounds.BoundsMin.z);
+                glm::vec2 p = glm::vec2(cachedMatrices[c] * glm::vec4(corner, 1.0f));
+                ndcMin = glm::min(ndcMin, p);
+                ndcMax = glm::max(ndcMax, p);
+            }
+            if (ndcMax.x >= -1.0f && ndcMin.x <= 1.0f && ndcMax.y >= -1.0f && ndcMin.y <= 1.0f)
+                valid[c] = false;
+        }
+    }
+
+    // fills every cascade of shadowMap: cached static depth plus freshly drawn dynamic casters.
+    // depthShader is used and its "lightSpaceMatrix" set before each callback.
+    void Render(CascadedShadowMap& shadowMap, Shader& depthShader, DrawCasters drawStatic, DrawCasters drawDynamic)
+    {
+        depthShader.use();
+        for (int c = 0; c < cascadeCount; c++)
+        {
+            const glm::mat4& matrix = shadowMap.GetCascade(c).LightSpaceMatrix;
+            depthShader.setMat4("lightSpaceMatrix", matrix);
+
+            if (!valid[c] || matrix != cachedMatrices[c])
+            {
+                glViewport(0, 0, resolution, resolution);
+                glBindFramebuffer(GL_FRAMEBUFFER, cacheFBO);
+                glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cacheArray, 0, c);
+                glClear(GL_DEPTH_BUFFER_BIT);
+                drawStatic(c);
+                cachedMatrices[c] = matrix;
+                valid[c] = true;
+                staticRedraws++;
+            }
+
+            // copy the cached layer into the live one, then add what moves
+            shadowMap.BeginCascade(c, false);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, cacheFBO);
+            glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cacheArray, 0, c);
+            glBlitFramebuffer(0, 0, resolution, resolution, 0, 0, resolution, resolution, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, shadowMap.FBO);
+            // the cascade's depth range was fitted to the static casters only
+            glEnable(GL_DEPTH_CLAMP);
+            drawDynamic(c);
+            glDisable(GL_DEPTH_CLAMP);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // number of layers redrawn from static casters since the last call
+    unsigned int TakeStaticRedraws()
+    {
+        unsigned int redraws = staticRedraws;
+        staticRedraws = 0;
+        return redraws;
+    }
+
+private:
+    int resolution;
+    int cascadeCount;
+    unsigned int cacheFBO;
+    unsigned int cacheArray;
+    bool valid[CascadedShadowMap::MAX_CASCADES];
+    glm::mat4 cachedMatrices[CascadedShadowMap::MAX_CASCADES];
+    unsigned int staticRedraws;
+};
@@ -0,0 +1,134 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <vector>
+#include <cmath>
+
+// Per-vertex tangent frame generation following the MikkTSpace conventions:
+// triangle tangents are weighted by the corner angle, orthogonalised against the
+// vertex normal, and the bitangent is not stored but rebuilt in the shader as
+// sign * cross(N, T) where sign lives in the tangent's w component. Vertices on
+// mirrored-UV seams are split, so the sign is never averaged across the mirror.
+class TangentSpace
+{
+public:
+	// writes a packed GL_INT_2_10_10_10_REV tangent into every vertex of the mesh.
+	// A vertex shared by triangles of opposite UV handedness (a mirrored-UV seam)
+	// is split: the mirrored triangles get a copy of it, so each copy averages
+	// only tangents of its own handedness and keeps a bitangent sign that fits its
+	// triangles. Expects welded vertices (aiProcess_JoinIdenticalVertices), so the
+	// triangles around a smooth corner share it and their tangents are averaged.
+	// ------------------------------------------------------------------------
+	template <typename VertexT>
+	static void Generate(std::vector<VertexT>& vertices, std::vector<unsigned int>& indices)
+	{
+		size_t triangleCount = indices.size() / 3;
+		std::vector<glm::vec3> triangleTangents(triangleCount), triangleBitangents(triangleCount);
+		std::vector<signed char> triangleSigns(triangleCount, 0);
+		// bit 0: used by a right-handed triangle, bit 1: by a mirrored one
+		std::vector<unsigned char> usedSigns(vertices.size(), 0);
+
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			const unsigned int* corner = &indices[t * 3];
+			const glm::vec3& p0 = vertices[corner[0]].Position;
+			const glm::vec3& p1 = vertices[corner[1]].Position;
+			const glm::vec3& p2 = vertices[corner[2]].Position;
+			const glm::vec2& uv0 = vertices[corner[0]].TexCoords;
+			const glm::vec2& uv1 = vertices[corner[1]].TexCoords;
+			const glm::vec2& uv2 = vertices[corner[2]].TexCoords;
+
+			glm::vec3 edge1 = p1 - p0;
+			glm::vec3 edge2 = p2 - p0;
+			glm::vec2 deltaUV1 = uv1 - uv0;
+			glm::vec2 deltaUV2 = uv2 - uv0;
+
+			float det = deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y;
+			if (std::fabs(det) < 1e-12f)
+				continue;
+			float f = 1.0f / det;
+			triangleTangents[t] = f * (deltaUV2.y * edge1 - deltaUV1.y * edge2);
+			triangleBitangents[t] = f * (deltaUV1.x * edge2 - deltaUV2.x * edge1);
+
+			glm::vec3 faceNormal = glm::cross(edge1, edge2);
+			triangleSigns[t] = glm::dot(glm::cross(faceNormal, triangleTangents[t]), triangleBitangents[t]) < 0.0f ? -1 : 1;
+			for (int c = 0; c < 3; c++)
+				usedSigns[corner[c]] |= triangleSigns[t] < 0 ? 2 : 1;
+		}
+
+		std::vector<unsigned int> mirroredCopy(vertices.size(), 0);
+		size_t originalCount = vertices.size();
+		for (size_t i = 0; i < originalCount; i++)
+		{
+			if (usedSigns[i] == 3)
+			{
+				VertexT copy = vertices[i];
+				mirroredCopy[i] = (unsigned int)vertices.size();
+				vertices.push_back(copy);
+			}
+		}
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			if (triangleSigns[t] >= 0)
+				continue;
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int& index = indices[t * 3 + c];
+				if (index < originalCount && usedSigns[index] == 3)
+					index = mirroredCopy[index];
+			}
+		}
+
+		std::vector<glm::vec3> tangents(vertices.size(), glm::vec3(0.0f));
+		std::vector<glm::vec3> bitangents(vertices.size(), glm::vec3(0.0f));
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			if (triangleSigns[t] == 0)
+				continue;
+			const unsigned int* corner = &indices[t * 3];
+			for (int c = 0; c < 3; c++)
+			{
+				const glm::vec3& p = vertices[corner[c]].Position;
+				glm::vec3 a = vertices[corner[(c + 1) % 3]].Position - p;
+				glm::vec3 b = vertices[corner[(c + 2) % 3]].Position - p;
+				float weight = cornerAngle(a, b);
+				tangents[corner[c]] += triangleTangents[t] * weight;
+				bitangents[corner[c]] += triangleBitangents[t] * weight;
+			}
+		}
+
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			glm::vec3 n = vertices[i].Normal;
+			float nLength = glm::length(n);
+			n = nLength > 0.0f ? n / nLength : glm::vec3(0.0f, 0.0f, 1.0f);
+
+			// Gram-Schmidt orthogonalize
+			glm::vec3 t = tangents[i] - n * glm::dot(n, tangents[i]);
+			float tLength = glm::length(t);
+			if (tLength < 1e-6f)
+				t = anyPerpendicular(n);
+			else
+				t /= tLength;
+
+			float handedness = glm::dot(glm::cross(n, t), bitangents[i]) < 0.0f ? -1.0f : 1.0f;
+			vertices[i].Tangent = glm::packSnorm3x10_1x2(glm::vec4(t, handedness));
+		}
+	}
+
+private:
+	static float cornerAngle(const glm::vec3& a, const glm::vec3& b)
+	{
+		float la = glm::length(a);
+		float lb = glm::length(b);
+		if (la <= 0.0f || lb <= 0.0f)
+			return 0.0f;
+		return std::acos(glm::clamp(glm::dot(a, b) / (la * lb), -1.0f, 1.0f));
+	}
+
+	static glm::vec3 anyPerpendicular(const glm::vec3& n)
+	{
+		glm::vec3 axis = std::fabs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		return glm::normalize(glm::cross(axis, n));
+	}
+};
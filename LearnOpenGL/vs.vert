@@ -1,24 +0,0 @@
-#version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
-layout (location = 2) in vec2 aTexCoords;
-
-out vec3 VertPos;
-
-out VS_OUT {
-	vec2 texCoords;
-    vec3 normal;
-} vs_out;
-
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-
-void main()
-{
-	vs_out.normal = mat3(transpose(inverse(model))) * aNormal;
-	VertPos = vec3(model * vec4(aPos, 1.0));
-	vs_out.texCoords = aTexCoords;
-
-	gl_Position = projection * view * model * vec4(aPos, 1.0);
-}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+// NORMAL_MAP 1 for meshes with a texture_normal, the tangent comes packed from tangentspace.h
+#ifndef NORMAL_MAP
+#define NORMAL_MAP 0
+#endif
+#if NORMAL_MAP
+layout (location = 7) in vec4 aTangent;
+out vec4 Tangent;
+#endif
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 VertPos;
+out float ViewDepth;
+
+// the depth prepass (vs_prepass.vert) computes the same position
+invariant gl_Position;
+
+uniform mat4 model;
+uniform mat3 normalMatrix;  // normalmatrix.h, mat3(model) when the scale is uniform
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+	Normal = normalMatrix * aNormal;
+#if NORMAL_MAP
+	// tangents lie in the surface, so they transform like positions; w is the bitangent sign
+	Tangent = vec4(mat3(model) * aTangent.xyz, aTangent.w);
+#endif
+	VertPos = vec3(model * vec4(aPos, 1.0));
+	TexCoords = aTexCoords;
+
+	// positive distance along the view direction, selects the cluster depth slice
+	vec4 viewPos = view * vec4(VertPos, 1.0);
+	ViewDepth = -viewPos.z;
+
+	gl_Position = projection * viewPos;
+}
@@ -3,25 +3,49 @@ layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texCoords;
 
+// permutation switch, INSTANCING=1 reads the model matrix from attributes 3-6
+#ifndef INSTANCING
+#define INSTANCING 0
+#endif
+#if INSTANCING
+layout (location = 3) in mat4 instanceMatrix;
+#endif
+// NORMAL_MATRIX=0 when every model matrix only scales uniformly, mat3(model) then maps normals too.
+// Otherwise the CPU computes transpose(inverse(mat3(model))) (normalmatrix.h), per instance in attributes 8-10.
+#ifndef NORMAL_MATRIX
+#define NORMAL_MATRIX 1
+#endif
+#if NORMAL_MATRIX && INSTANCING
+layout (location = 8) in mat3 instanceNormalMatrix;
+#endif
+
 out vec2 TexCoords;
 
 out VS_OUT {
     vec3 FragPos;
     vec3 Normal;
     vec2 TexCoords;
-    vec4 FragPosLightSpace;
 } vs_out;
 
 uniform mat4 projection;
 uniform mat4 view;
+#if INSTANCING
+#define model instanceMatrix
+#else
 uniform mat4 model;
-uniform mat4 lightSpaceMatrix;
+#endif
+#if NORMAL_MATRIX && INSTANCING
+#define normalMatrix instanceNormalMatrix
+#elif NORMAL_MATRIX
+uniform mat3 normalMatrix;
+#else
+#define normalMatrix mat3(model)
+#endif
 
 void main()
 {
     gl_Position = projection * view * model * vec4(position, 1.0f);
     vs_out.FragPos = vec3(model * vec4(position, 1.0));
-    vs_out.Normal = transpose(inverse(mat3(model))) * normal;
+    vs_out.Normal = normalMatrix * normal;
     vs_out.TexCoords = texCoords;
-    vs_out.FragPosLightSpace = lightSpaceMatrix * vec4(vs_out.FragPos, 1.0);
-}
\ No newline at end of file
+}
@@ -3,6 +3,14 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 layout (location = 3) in mat4 instanceMatrix;
+// NORMAL_MATRIX=1 reads transpose(inverse(mat3(instanceMatrix))) from attributes 8-10,
+// 0 when every instance scales uniformly and mat3(instanceMatrix) maps normals as well
+#ifndef NORMAL_MATRIX
+#define NORMAL_MATRIX 1
+#endif
+#if NORMAL_MATRIX
+layout (location = 8) in mat3 instanceNormalMatrix;
+#endif
 
 out vec2 TexCoords;
 out vec3 Normal;
@@ -12,7 +20,11 @@ uniform mat4 view;
 
 void main()
 {
-    Normal = aNormal;
+#if NORMAL_MATRIX
+    Normal = instanceNormalMatrix * aNormal;
+#else
+    Normal = mat3(instanceMatrix) * aNormal;
+#endif
     TexCoords = aTexCoords;
     gl_Position = projection * view * instanceMatrix * vec4(aPos, 1.0f); 
 }
\ No newline at end of file
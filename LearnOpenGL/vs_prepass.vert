@@ -0,0 +1,16 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+// must produce bit-identical depth to vs_clustered.vert, so the lit pass can test with GL_LEQUAL
+invariant gl_Position;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+	vec3 vertPos = vec3(model * vec4(aPos, 1.0));
+	vec4 viewPos = view * vec4(vertPos, 1.0);
+	gl_Position = projection * viewPos;
+}
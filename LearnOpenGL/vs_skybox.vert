@@ -1,6 +1,8 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 
+#include "depth.glsl"
+
 out vec3 TexCoords;
 
 uniform mat4 projection;
@@ -10,5 +12,6 @@ void main()
 {
     TexCoords = aPos;
     vec4 pos = projection * view * vec4(aPos, 1.0);
-    gl_Position = pos.xyww;
+    // always on the far plane, drawn last with the or-equal depth test
+    gl_Position = vec4(pos.xy, FAR_CLIP_Z * pos.w, pos.w);
 }
\ No newline at end of file
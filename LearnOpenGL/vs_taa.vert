@@ -5,11 +5,19 @@ layout (location = 1) in vec2 aTexCoords;
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+// unjittered, for the motion vectors
+uniform mat4 viewProjection;
+uniform mat4 previousModel;
+uniform mat4 previousViewProjection;
 
 out vec2 TexCoords;
+out vec4 CurrentPosition;
+out vec4 PreviousPosition;
 
 void main()
 {
 	TexCoords = aTexCoords;
+	CurrentPosition = viewProjection * model * vec4(aPos, 1.0);
+	PreviousPosition = previousViewProjection * previousModel * vec4(aPos, 1.0);
 	gl_Position = projection * view * model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+}
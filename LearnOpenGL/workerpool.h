@@ -0,0 +1,110 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+
+// Threads created once and parked on a condition variable between batches, so
+// per-frame work (light assignment, cascade fitting) does not pay for thread
+// creation every frame. ParallelFor() hands out job indices through an atomic
+// counter to the workers and the calling thread and returns when all ran.
+// One caller at a time; the destructor wakes the workers and joins them.
+class WorkerPool
+{
+public:
+    // threadCount 0: one thread per core besides the caller's
+    explicit WorkerPool(unsigned int threadCount = 0)
+    {
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+        for (unsigned int i = 0; i < threadCount; i++)
+            threads.push_back(std::thread(&WorkerPool::workerLoop, this));
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (unsigned int i = 0; i < threads.size(); i++)
+            threads[i].join();
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    unsigned int ThreadCount() const
+    {
+        return (unsigned int)threads.size();
+    }
+
+    // calls job(i) for every i < count, in no particular order
+    void ParallelFor(unsigned int count, const std::function<void(unsigned int)>& job)
+    {
+        if (threads.empty() || count <= 1)
+        {
+            for (unsigned int i = 0; i < count; i++)
+                job(i);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            currentJob = &job;
+            jobCount = count;
+            next = 0;
+            generation++;
+        }
+        wake.notify_all();
+        runJobs(job, count);
+
+        // a worker that wakes after the last index was taken finds nothing left and leaves at once
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]() { return busy == 0; });
+        currentJob = nullptr;
+    }
+
+private:
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(unsigned int)>* currentJob = nullptr;  // guarded by mutex
+    unsigned int jobCount = 0;                                      // guarded by mutex
+    unsigned long long generation = 0;                              // guarded by mutex, one per batch
+    unsigned int busy = 0;                                          // guarded by mutex, workers inside a batch
+    bool stopping = false;                                          // guarded by mutex
+    std::atomic<unsigned int> next{ 0 };
+
+    void runJobs(const std::function<void(unsigned int)>& job, unsigned int count)
+    {
+        for (unsigned int i = next++; i < count; i = next++)
+            job(i);
+    }
+
+    void workerLoop()
+    {
+        unsigned long long seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            wake.wait(lock, [&]() { return stopping || (generation != seen && currentJob != nullptr); });
+            if (stopping)
+                return;
+            seen = generation;
+            const std::function<void(unsigned int)>& job = *currentJob;
+            unsigned int count = jobCount;
+            busy++;
+            lock.unlock();
+            runJobs(job, count);
+            lock.lock();
+            if (--busy == 0)
+                done.notify_all();
+        }
+    }
+};